@@ -8,7 +8,7 @@
 #include "../Defines/Debug.h"
 
 
-ACelestialBody::ACelestialBody()
+ACelestialBody::ACelestialBody(): bKinematic(false), bMasslessTracer(false), RegistryHandle(INDEX_NONE)
 {
 	PrimaryActorTick.bCanEverTick = true;
 	SetMeshComponent();
@@ -20,9 +20,13 @@ void ACelestialBody::BeginPlay()
 	SetCurrentVelocity(InitialVelocity);
 	SetRadius();
 	MassCalculation();
-	
-	FTimerHandle TimerHandle;
-	GetWorldTimerManager().SetTimer(TimerHandle, this, &ACelestialBody::AddBodyToRegistry, 0.5f, false);
+	AddBodyToRegistry();
+}
+
+void ACelestialBody::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	RemoveBodyFromRegistry();
+	Super::EndPlay(EndPlayReason);
 }
 
 void ACelestialBody::SetMeshComponent()
@@ -33,10 +37,23 @@ void ACelestialBody::SetMeshComponent()
 	MeshComponent->SetEnableGravity(false);
 }
 
-void ACelestialBody::SetMass(const float& NewMass)
+void ACelestialBody::SetMass(const double& NewMass)
 {
 	Mass = NewMass;
-	MeshComponent->SetMassOverrideInKg(NAME_None, Mass, true);
+	MeshComponent->SetMassOverrideInKg(NAME_None, static_cast<float>(Mass), true);
+}
+
+/**
+ * Switches the body between the physics engine and the orbit simulation. A kinematic body is not simulated by
+ * the physics engine, its location is only written by the simulation, which keeps the motion deterministic.
+ * It keeps its collision, so characters and other actors still collide with it as with any moved kinematic body.
+ */
+void ACelestialBody::SetKinematic(const bool& bNewKinematic)
+{
+	if (bKinematic == bNewKinematic) return;
+	
+	bKinematic = bNewKinematic;
+	MeshComponent->SetSimulatePhysics(!bKinematic);
 }
 
 void ACelestialBody::UpdateVelocity(const FVector& Acceleration, const float& TimeStep)
@@ -49,10 +66,24 @@ void ACelestialBody::UpdatePosition(const float& TimeStep) const
 	MeshComponent->SetPhysicsLinearVelocity(CurrentVelocity * TimeStep);
 }
 
+void ACelestialBody::SetSimulatedLocation(const FVector& NewLocation)
+{
+	if (bKinematic)
+	{
+		// Without a rigid body there is nothing to teleport, the component is just moved
+		MeshComponent->SetWorldLocation(NewLocation, false, nullptr, ETeleportType::None);
+		return;
+	}
+	
+	// The orbit integrator owns the position, so the physics body must not drift on its own
+	MeshComponent->SetPhysicsLinearVelocity(FVector::ZeroVector);
+	SetActorLocation(NewLocation, false, nullptr, ETeleportType::TeleportPhysics);
+}
+
 void ACelestialBody::MassCalculation()
 {
 	Mass = Radius * Radius / FUniverse::GravitationalConstant;
-	MeshComponent->SetMassOverrideInKg(NAME_None, Mass, true);
+	MeshComponent->SetMassOverrideInKg(NAME_None, static_cast<float>(Mass), true);
 }
 
 void ACelestialBody::AddBodyToRegistry()
@@ -63,7 +94,7 @@ void ACelestialBody::AddBodyToRegistry()
 		ACelestialBodyRegistry* Registry = GameMode->GetCelestialBodyRegistry();
 		if (Registry)
 		{
-			Registry->OnCelestialBodyAdded.Broadcast(this);
+			Registry->AddCelestialObject(this);
 		}
 		else
 		{
@@ -76,3 +107,15 @@ void ACelestialBody::AddBodyToRegistry()
 	}
 }
 
+void ACelestialBody::RemoveBodyFromRegistry()
+{
+	if (RegistryHandle == INDEX_NONE) return;
+
+	// At the end of the game the game mode or the registry may already be gone
+	const AOrbitSimulation_GameMode* GameMode = Cast<AOrbitSimulation_GameMode>(GetWorld()->GetAuthGameMode());
+	ACelestialBodyRegistry* Registry = GameMode ? GameMode->GetCelestialBodyRegistry() : nullptr;
+	if (IsValid(Registry))
+	{
+		Registry->RemoveCelestialObject(this);
+	}
+}
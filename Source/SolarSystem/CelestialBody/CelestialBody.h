@@ -16,15 +16,16 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	UPROPERTY(VisibleAnywhere)
 	UStaticMeshComponent* MeshComponent;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Celestial Body")
-	float Mass;
+	double Mass;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Body")
-	float Radius;
+	double Radius;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Celestial Body")
 	FVector InitialVelocity;
@@ -32,26 +33,50 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Body")
 	FVector CurrentVelocity;
 
+	// Kinematic bodies do not simulate physics, the orbit simulation moves them directly.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Body")
+	bool bKinematic;
+
+	// A massless tracer feels the gravity of the other bodies but exerts none, like dust or a small moon next to
+	// its planet. Tracers are far cheaper to simulate. Read when the body joins the simulation.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Celestial Body")
+	bool bMasslessTracer;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug Options")
 	mutable FLinearColor LineColor;
 	
 public:
-	float GetMass() const { return Mass; }
-	void SetMass(const float& NewMass);
+	double GetMass() const { return Mass; }
+	void SetMass(const double& NewMass);
 
-	float GetRadius() const { return Radius; }
+	double GetRadius() const { return Radius; }
 	void SetRadius() { Radius = MeshComponent->Bounds.SphereRadius; }
 
 	FVector GetInitialVelocity() const { return InitialVelocity; }
+	FVector GetCurrentVelocity() const { return CurrentVelocity; }
 	void SetCurrentVelocity(const FVector& NewVelocity) { CurrentVelocity = NewVelocity; }
 
 	FLinearColor GetLineColor() const { return LineColor; }
+
+	bool IsKinematic() const { return bKinematic; }
+	void SetKinematic(const bool& bNewKinematic);
+
+	bool IsMasslessTracer() const { return bMasslessTracer; }
+
+	int32 GetRegistryHandle() const { return RegistryHandle; }
 	
 	void UpdatePosition(const float& TimeStep) const;
+	void SetSimulatedLocation(const FVector& NewLocation);
 	void UpdateVelocity(const FVector& Acceleration, const float& TimeStep);
 
 private:
+	friend class ACelestialBodyRegistry;
+	
+	// Handle in the celestial body registry, INDEX_NONE while the body is not registered
+	int32 RegistryHandle;
+	
 	void SetMeshComponent();
 	void MassCalculation();
 	void AddBodyToRegistry();
+	void RemoveBodyFromRegistry();
 };
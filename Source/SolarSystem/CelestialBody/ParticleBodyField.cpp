@@ -0,0 +1,108 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#include "ParticleBodyField.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "SolarSystem/GameModes/OrbitSimulation_GameMode.h"
+#include "SolarSystem/Orbit/ACelestialBodyRegistry.h"
+#include "SolarSystem/Structs/Universe.h"
+#include "../Defines/Debug.h"
+
+
+AParticleBodyField::AParticleBodyField(): CentralBody(nullptr)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	InstanceComponent = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("InstanceComponent"));
+	InstanceComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstanceComponent->SetMobility(EComponentMobility::Movable);
+	RootComponent = InstanceComponent;
+}
+
+void AParticleBodyField::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// The central body may begin play after the field. By the next tick every actor of the level has begun play,
+	// so the central body has its mass when the orbits are set up.
+	GetWorldTimerManager().SetTimerForNextTick(this, &AParticleBodyField::AddFieldToRegistry);
+}
+
+void AParticleBodyField::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	const AOrbitSimulation_GameMode* GameMode = Cast<AOrbitSimulation_GameMode>(GetWorld()->GetAuthGameMode());
+	ACelestialBodyRegistry* Registry = GameMode ? GameMode->GetCelestialBodyRegistry() : nullptr;
+	if (IsValid(Registry))
+	{
+		Registry->RemoveParticleField(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+/**
+ * Scatters the bodies over a disc around the central body with a reproducible random stream. The instances are
+ * created once here, later updates only move them.
+ */
+void AParticleBodyField::GenerateBodies()
+{
+	const FVector Center = CentralBody ? CentralBody->GetActorLocation() : GetActorLocation();
+	const FVector CenterVelocity = CentralBody ? CentralBody->GetInitialVelocity() : FVector::ZeroVector;
+	const double CentralMass = CentralBody ? CentralBody->GetMass() : 0.0;
+	const FQuat Rotation = GetActorQuat();
+
+	FRandomStream Random(Seed);
+	Masses.SetNumUninitialized(NumBodies);
+	InitialPositions.SetNumUninitialized(NumBodies);
+	InitialVelocities.SetNumUninitialized(NumBodies);
+	InstanceTransforms.SetNum(NumBodies);
+	for (int i = 0; i < NumBodies; ++i)
+	{
+		const float Radius = Random.FRandRange(InnerRadius, OuterRadius);
+		const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+		const FVector Direction = Rotation.RotateVector(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f));
+		const FVector Tangent = Rotation.RotateVector(FVector(-FMath::Sin(Angle), FMath::Cos(Angle), 0.0f));
+		const FVector Height = Rotation.GetUpVector() * Random.FRandRange(-0.5f, 0.5f) * Thickness;
+		const double Speed = FMath::Sqrt(FUniverse::GravitationalConstant * CentralMass / FMath::Max(Radius, 1.0f));
+
+		// The same draw as FRandRange, computed in double
+		Masses[i] = FMath::Lerp(MinMass, MaxMass, static_cast<double>(Random.GetFraction()));
+		InitialPositions[i] = Center + Direction * Radius + Height;
+		InitialVelocities[i] = CenterVelocity + Tangent * Speed;
+		InstanceTransforms[i] = FTransform(FQuat::Identity, InitialPositions[i], FVector(InstanceScale));
+	}
+
+	InstanceComponent->ClearInstances();
+	InstanceComponent->AddInstances(InstanceTransforms, false, true);
+}
+
+void AParticleBodyField::UpdateInstances(const TFunctionRef<FVector(int Index)> GetLocation)
+{
+	for (int i = 0; i < InstanceTransforms.Num(); ++i)
+	{
+		InstanceTransforms[i].SetTranslation(GetLocation(i));
+	}
+	InstanceComponent->BatchUpdateInstancesTransforms(0, InstanceTransforms, true, true, true);
+}
+
+void AParticleBodyField::AddFieldToRegistry()
+{
+	GenerateBodies();
+
+	AOrbitSimulation_GameMode* GameMode = Cast<AOrbitSimulation_GameMode>(GetWorld()->GetAuthGameMode());
+	if (GameMode)
+	{
+		ACelestialBodyRegistry* Registry = GameMode->GetCelestialBodyRegistry();
+		if (Registry)
+		{
+			Registry->AddParticleField(this);
+		}
+		else
+		{
+			LOG_ERROR_F("Failed to get CelestialObjectManager from Game Mode! @ %s", *GetName());
+		}
+	}
+	else
+	{
+		LOG_ERROR_F("Failed to cast Game Mode! @ %s", *GetName());
+	}
+}
@@ -0,0 +1,95 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CelestialBody.h"
+#include "GameFramework/Actor.h"
+#include "ParticleBodyField.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/**
+ * A field of small bodies, like an asteroid belt or debris, without an actor per body. The bodies take part in
+ * the gravity of the orbit simulation like celestial bodies, but they are drawn as instances of one mesh whose
+ * transforms the simulation writes in a single batch per frame.
+ *
+ * The instances move every frame, so a plain instanced mesh is used. A hierarchical one would rebuild its
+ * cluster tree after every update.
+ */
+UCLASS()
+class SOLARSYSTEM_API AParticleBodyField : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AParticleBodyField();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(VisibleAnywhere)
+	UInstancedStaticMeshComponent* InstanceComponent;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0"))
+	int NumBodies = 1000;
+
+	// The bodies start on circular orbits around this body, or at rest around the field if there is none.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies")
+	ACelestialBody* CentralBody;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	float InnerRadius = 5000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	float OuterRadius = 8000.0f;
+
+	// Height of the disc along the up axis of the field.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	float Thickness = 200.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	double MinMass = 1.0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	double MaxMass = 10.0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies")
+	int Seed = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies", meta = (ClampMin = "0.0"))
+	float InstanceScale = 1.0f;
+
+	// The bodies only feel the gravity of the massive bodies and exert none themselves. This makes a field of
+	// N bodies cost O(N * massive bodies) instead of O(N^2), the right choice for rings and belts.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Particle Bodies")
+	bool bMasslessTracers = false;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Particle Bodies")
+	TArray<double> Masses;
+
+	TArray<FVector> InitialPositions;
+	TArray<FVector> InitialVelocities;
+
+public:
+	int GetNumBodies() const { return Masses.Num(); }
+	bool AreMasslessTracers() const { return bMasslessTracers; }
+	double GetMass(const int Index) const { return Masses[Index]; }
+	FVector GetInitialPosition(const int Index) const { return InitialPositions[Index]; }
+	FVector GetInitialVelocity(const int Index) const { return InitialVelocities[Index]; }
+
+	/**
+	 * Moves all instances in one batch and marks the render state dirty once.
+	 *
+	 * @param GetLocation Returns the world location of a body.
+	 */
+	void UpdateInstances(const TFunctionRef<FVector(int Index)> GetLocation);
+
+private:
+	// Reused between the updates, so a frame does not allocate
+	TArray<FTransform> InstanceTransforms;
+
+	void GenerateBodies();
+	void AddFieldToRegistry();
+};
@@ -0,0 +1,308 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "OrbitSimCommandlet.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "SolarSystem/Structs/GravitySolver.h"
+#include "SolarSystem/Structs/OrbitIntegrator.h"
+#include "SolarSystem/Structs/Universe.h"
+#include "../Defines/Debug.h"
+
+/**
+ * Replaces the bodies of the core, relative to the heaviest one with a floating origin.
+ */
+template <typename CoreType>
+static void SetCoreBodies(CoreType& Core, const FOrbitStateDouble& Bodies)
+{
+	Core.State.SetNum(Bodies.Num());
+	Core.Origin = FVector::ZeroVector;
+	if (Core.Settings.bFloatingOrigin && Bodies.Num() > 0)
+	{
+		int32 OriginBody = 0;
+		for (int32 i = 1; i < Bodies.Num(); ++i)
+		{
+			if (Bodies.Mass[i] > Bodies.Mass[OriginBody])
+			{
+				OriginBody = i;
+			}
+		}
+		Core.Origin = Bodies.GetPosition(OriginBody);
+	}
+
+	for (int32 i = 0; i < Bodies.Num(); ++i)
+	{
+		Core.State.Mass[i] = Bodies.Mass[i];
+		Core.SetWorldPosition(i, Bodies.GetPosition(i));
+		Core.State.SetVelocity(i, Bodies.GetVelocity(i));
+	}
+	Core.Invalidate();
+}
+
+template <typename CoreType>
+static void GetCoreBodies(const CoreType& Core, FOrbitStateDouble& OutBodies)
+{
+	OutBodies.SetNum(Core.State.Num());
+	for (int32 i = 0; i < Core.State.Num(); ++i)
+	{
+		OutBodies.Mass[i] = Core.State.Mass[i];
+		OutBodies.SetPosition(i, Core.GetWorldPosition(i));
+		OutBodies.SetVelocity(i, Core.State.GetVelocity(i));
+	}
+}
+
+
+UOrbitSimCommandlet::UOrbitSimCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UOrbitSimCommandlet::Main(const FString& Params)
+{
+	FParse::Value(*Params, TEXT("Theta="), Settings.OpeningAngle);
+	FParse::Value(*Params, TEXT("Softening="), Settings.SofteningLength);
+	FParse::Value(*Params, TEXT("BatchSize="), Settings.ParallelBatchSize);
+	Settings.bDoublePrecision = FParse::Param(*Params, TEXT("Double"));
+	Settings.bFloatingOrigin = FParse::Param(*Params, TEXT("FloatingOrigin"));
+
+	FString IntegratorName;
+	if (FParse::Value(*Params, TEXT("Integrator="), IntegratorName))
+	{
+		const int64 Value = StaticEnum<EOrbitIntegrator>()->GetValueByNameString(IntegratorName);
+		if (Value == INDEX_NONE)
+		{
+			LOG_ERROR_F("Unknown integrator %s", *IntegratorName);
+			return 1;
+		}
+		Settings.Integrator = ToCore(static_cast<EOrbitIntegrator>(Value));
+	}
+
+	FString SolverName;
+	if (FParse::Value(*Params, TEXT("Solver="), SolverName))
+	{
+		const int64 Value = StaticEnum<EGravitySolver>()->GetValueByNameString(SolverName);
+		if (Value == INDEX_NONE)
+		{
+			LOG_ERROR_F("Unknown gravity solver %s", *SolverName);
+			return 1;
+		}
+		Settings.GravitySolver = ToCore(static_cast<EGravitySolver>(Value));
+	}
+
+	return FParse::Param(*Params, TEXT("Benchmark")) ? RunBenchmark(Params) : RunSimulation(Params);
+}
+
+int32 UOrbitSimCommandlet::RunSimulation(const FString& Params)
+{
+	FString InputPath;
+	if (!FParse::Value(*Params, TEXT("Input="), InputPath))
+	{
+		LOG_ERROR("OrbitSim: Missing -Input=<Bodies.csv>");
+		return 1;
+	}
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("OrbitSim") / TEXT("FinalState.csv");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	int32 NumSteps = 1000;
+	float TimeStep = FUniverse::TimeStep;
+	FParse::Value(*Params, TEXT("Steps="), NumSteps);
+	FParse::Value(*Params, TEXT("TimeStep="), TimeStep);
+
+	FOrbitStateDouble Bodies;
+	if (!LoadBodies(InputPath, Bodies))
+	{
+		return 1;
+	}
+
+	const double Seconds = Cores.Visit(Settings.bDoublePrecision, [this, &Bodies, NumSteps, TimeStep](auto& Core)
+	{
+		Core.Settings = Settings;
+		SetCoreBodies(Core, Bodies);
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			Core.Step(TimeStep);
+		}
+		const double EndTime = FPlatformTime::Seconds();
+
+		GetCoreBodies(Core, Bodies);
+		return EndTime - StartTime;
+	});
+
+	TArray<FString> Header;
+	Header.Add(FString::Printf(TEXT("# Bodies %d, Steps %d, TimeStep %g, Integrator %s, Solver %s, Precision %s"), Bodies.Num(), NumSteps,
+		TimeStep, *StaticEnum<EOrbitIntegrator>()->GetNameStringByValue(static_cast<int64>(Settings.Integrator)),
+		*StaticEnum<EGravitySolver>()->GetNameStringByValue(static_cast<int64>(Settings.GravitySolver)),
+		Settings.bDoublePrecision ? TEXT("Double") : TEXT("Float")));
+	Header.Add(FString::Printf(TEXT("# Seconds %.6f, Steps per second %.2f"), Seconds, NumSteps > 0 ? NumSteps / Seconds : 0.0));
+	Header.Add(TEXT("# Mass, X, Y, Z, VX, VY, VZ"));
+
+	if (!SaveBodies(OutputPath, Bodies, Header))
+	{
+		return 1;
+	}
+
+	LOG_DISPLAY_F("%d bodies, %d steps in %.3f s, written to %s", Bodies.Num(), NumSteps, Seconds, *OutputPath);
+	return 0;
+}
+
+/**
+ * Steps generated systems of 10, 100, ... up to MaxBodies bodies with every gravity solver in both precisions for
+ * at least MinTime seconds each and writes the steps per second as a table. The first step of every run is not measured, so the
+ * allocations of the integrator and the tree are not part of the result.
+ */
+int32 UOrbitSimCommandlet::RunBenchmark(const FString& Params)
+{
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("OrbitSim") / TEXT("Benchmark.csv");
+	int32 MaxBodies = 100000;
+	double MinTime = 1.0;
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	FParse::Value(*Params, TEXT("MaxBodies="), MaxBodies);
+	FParse::Value(*Params, TEXT("MinTime="), MinTime);
+
+	const FString IntegratorName = StaticEnum<EOrbitIntegrator>()->GetNameStringByValue(static_cast<int64>(Settings.Integrator));
+	TArray<FString> Lines;
+	Lines.Add(FString::Printf(TEXT("# Integrator %s, Theta %g, Softening %g, BatchSize %d"), *IntegratorName, Settings.OpeningAngle,
+		Settings.SofteningLength, Settings.ParallelBatchSize));
+	Lines.Add(TEXT("# Precision, Solver, Bodies, Steps, Seconds, Steps per second"));
+
+	FOrbitStateDouble Bodies;
+	const OrbitCore::ESolver Solvers[] = { OrbitCore::ESolver::DirectSum, OrbitCore::ESolver::BarnesHut };
+	for (const bool bDoublePrecision : { false, true })
+	{
+		Settings.bDoublePrecision = bDoublePrecision;
+		const TCHAR* PrecisionName = bDoublePrecision ? TEXT("Double") : TEXT("Float");
+
+		for (const OrbitCore::ESolver Solver : Solvers)
+		{
+			Settings.GravitySolver = Solver;
+			const FString SolverName = StaticEnum<EGravitySolver>()->GetNameStringByValue(static_cast<int64>(Solver));
+
+			for (int32 NumBodies = 10; NumBodies <= MaxBodies; NumBodies *= 10)
+			{
+				GenerateBodies(NumBodies, Bodies);
+
+				int32 NumSteps = 0;
+				const double Seconds = Cores.Visit(bDoublePrecision, [this, &Bodies, &NumSteps, MinTime](auto& Core)
+				{
+					Core.Settings = Settings;
+					SetCoreBodies(Core, Bodies);
+					Core.Step(FUniverse::TimeStep);
+
+					const double StartTime = FPlatformTime::Seconds();
+					double Elapsed = 0.0;
+					do
+					{
+						Core.Step(FUniverse::TimeStep);
+						++NumSteps;
+						Elapsed = FPlatformTime::Seconds() - StartTime;
+					}
+					while (Elapsed < MinTime);
+					return Elapsed;
+				});
+
+				Lines.Add(FString::Printf(TEXT("%s, %s, %d, %d, %.6f, %.3f"), PrecisionName, *SolverName, NumBodies, NumSteps, Seconds,
+					NumSteps / Seconds));
+				LOG_DISPLAY_F("%s, %s, %d bodies: %.3f steps per second", PrecisionName, *SolverName, NumBodies, NumSteps / Seconds);
+			}
+		}
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(Lines, *OutputPath))
+	{
+		LOG_ERROR_F("Failed to write %s", *OutputPath);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Fills the state with a reproducible disc of light bodies on roughly circular orbits around a heavy central body.
+ */
+void UOrbitSimCommandlet::GenerateBodies(const int32 NumBodies, FOrbitStateDouble& OutState)
+{
+	constexpr double CentralMass = 1.0e7;
+	constexpr float InnerRadius = 1000.0f;
+	constexpr float OuterRadius = 100000.0f;
+
+	FRandomStream Random(NumBodies);
+	OutState.SetNum(NumBodies);
+	OutState.Mass[0] = CentralMass;
+	for (int32 i = 1; i < NumBodies; ++i)
+	{
+		const float Radius = Random.FRandRange(InnerRadius, OuterRadius);
+		const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+		const FVector Direction(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f);
+		const double Speed = FMath::Sqrt(FUniverse::GravitationalConstant * CentralMass / Radius);
+
+		OutState.Mass[i] = Random.FRandRange(1.0f, 10.0f);
+		OutState.SetPosition(i, Direction * Radius + FVector(0.0f, 0.0f, Random.FRandRange(-100.0f, 100.0f)));
+		OutState.SetVelocity(i, FVector(-Direction.Y, Direction.X, 0.0f) * Speed);
+	}
+}
+
+bool UOrbitSimCommandlet::LoadBodies(const FString& Path, FOrbitStateDouble& OutState)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Path))
+	{
+		LOG_ERROR_F("Failed to read %s", *Path);
+		return false;
+	}
+
+	TArray<double> Values;
+	Values.Reserve(Lines.Num() * 7);
+	for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+	{
+		const FString Line = Lines[LineIndex].TrimStartAndEnd();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#"))) continue;
+
+		TArray<FString> Columns;
+		Line.ParseIntoArray(Columns, TEXT(","));
+		if (Columns.Num() != 7)
+		{
+			LOG_ERROR_F("%s(%d): Expected 7 columns, found %d", *Path, LineIndex + 1, Columns.Num());
+			return false;
+		}
+		for (const FString& Column : Columns)
+		{
+			Values.Add(FCString::Atod(*Column.TrimStartAndEnd()));
+		}
+	}
+
+	OutState.SetNum(Values.Num() / 7);
+	for (int32 i = 0; i < OutState.Num(); ++i)
+	{
+		const double* Body = &Values[i * 7];
+		OutState.Mass[i] = Body[0];
+		OutState.SetPosition(i, FVector(Body[1], Body[2], Body[3]));
+		OutState.SetVelocity(i, FVector(Body[4], Body[5], Body[6]));
+	}
+	return true;
+}
+
+bool UOrbitSimCommandlet::SaveBodies(const FString& Path, const FOrbitStateDouble& InState, const TArray<FString>& Header)
+{
+	TArray<FString> Lines = Header;
+	Lines.Reserve(Header.Num() + InState.Num());
+	for (int32 i = 0; i < InState.Num(); ++i)
+	{
+		const FVector Position = InState.GetPosition(i);
+		const FVector Velocity = InState.GetVelocity(i);
+		Lines.Add(FString::Printf(TEXT("%.17g, %.17g, %.17g, %.17g, %.17g, %.17g, %.17g"), InState.Mass[i], Position.X, Position.Y,
+			Position.Z, Velocity.X, Velocity.Y, Velocity.Z));
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(Lines, *Path))
+	{
+		LOG_ERROR_F("Failed to write %s", *Path);
+		return false;
+	}
+	return true;
+}
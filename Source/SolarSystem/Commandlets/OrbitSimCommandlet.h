@@ -0,0 +1,47 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SolarSystem/Orbit/OrbitSimulationCore.h"
+#include "SolarSystem/Structs/OrbitState.h"
+#include "OrbitSimCommandlet.generated.h"
+
+/**
+ * Runs the orbit simulation headless, without a world or any actor.
+ *
+ * Usage: UnrealEditor-Cmd <Project> -run=OrbitSim -Input=<Bodies.csv> [-Output=<State.csv>] [-Steps=1000]
+ *        [-TimeStep=0.1] [-Integrator=VelocityVerlet] [-Solver=DirectSum] [-Theta=0.5] [-Softening=0] [-BatchSize=0]
+ *        [-Double] [-FloatingOrigin]
+ *
+ * Every line of the input holds one body as "Mass, X, Y, Z, VX, VY, VZ", lines starting with # are skipped.
+ * The output holds the final state in the same format, preceded by comment lines with the timing.
+ *
+ * Benchmark: -run=OrbitSim -Benchmark [-Output=<Benchmark.csv>] [-MaxBodies=100000] [-MinTime=1.0] [-Integrator=...]
+ * Measures the steps per second of every gravity solver in float and double precision for generated systems
+ * of 10 up to MaxBodies bodies.
+ * The simulation core only depends on Core, so the numbers do not contain any actor or physics cost.
+ */
+UCLASS()
+class SOLARSYSTEM_API UOrbitSimCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UOrbitSimCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	int32 RunSimulation(const FString& Params);
+	int32 RunBenchmark(const FString& Params);
+
+	FOrbitSimulationSettings Settings;
+	FOrbitSimulationCores Cores;
+
+	// The bodies are read and written in double precision and world space, whatever the precision of the core
+	static bool LoadBodies(const FString& Path, FOrbitStateDouble& OutBodies);
+	static void GenerateBodies(const int32 NumBodies, FOrbitStateDouble& OutBodies);
+	static bool SaveBodies(const FString& Path, const FOrbitStateDouble& InBodies, const TArray<FString>& Header);
+};
@@ -9,13 +9,16 @@
  */
 struct FVirtualBody
 {
-	float Mass;
+	double Mass;
 
 	FVector Location;
 	FVector Velocity;
 
 	FLinearColor LineColor;
 
+	// Feels gravity but exerts none, see ACelestialBody
+	bool bMasslessTracer = false;
+
 	explicit FVirtualBody(const TWeakObjectPtr<ACelestialBody>& Body)
 	{
 		if (Body.IsValid())
@@ -24,6 +27,7 @@ struct FVirtualBody
 			Location = Body->GetActorLocation();
 			Velocity = Body->GetInitialVelocity();
 			LineColor = Body->GetLineColor();
+			bMasslessTracer = Body->IsMasslessTracer();
 		}
 	}
 };
@@ -3,9 +3,16 @@
 #include "OrbitDebug.h"
 
 #include "OrbitDrawComponent.h"
+#include "Async/Async.h"
+#include "Engine/Engine.h"
 #include "Kismet/GameplayStatics.h"
 #include "SolarSystem/Defines/Debug.h"
-#include "SolarSystem/Structs/Universe.h"
+
+DECLARE_STATS_GROUP(TEXT("OrbitDebug"), STATGROUP_OrbitDebug, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Run Orbit Debugger"), STAT_RunOrbitDebugger, STATGROUP_OrbitDebug);
+DECLARE_CYCLE_STAT(TEXT("Rebuild Splines"), STAT_RebuildSplines, STATGROUP_OrbitDebug);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spline Rebuilds"), STAT_SplineRebuilds, STATGROUP_OrbitDebug);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rebuilt Spline Points"), STAT_RebuiltSplinePoints, STATGROUP_OrbitDebug);
 
 AOrbitDebug::AOrbitDebug()
 {
@@ -19,24 +26,147 @@ AOrbitDebug::AOrbitDebug()
 	OrbitDrawComponent->SetupAttachment(Root);
 }
 
+void AOrbitDebug::Destroyed()
+{
+	CancelPendingPrediction();
+	Super::Destroyed();
+}
+
+#if WITH_EDITOR
+/**
+ * Listens to the edits of the celestial bodies and of this actor, so the preview follows a body that is dragged
+ * through the viewport or a changed initial velocity without predicting again every tick.
+ */
+void AOrbitDebug::PostRegisterAllComponents()
+{
+	Super::PostRegisterAllComponents();
+
+	if (!ObjectPropertyChangedHandle.IsValid())
+	{
+		ObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddUObject(this, &AOrbitDebug::OnObjectPropertyChanged);
+	}
+	if (GEngine && !ActorMovedHandle.IsValid())
+	{
+		ActorMovedHandle = GEngine->OnActorMoved().AddUObject(this, &AOrbitDebug::OnActorChanged);
+		LevelActorAddedHandle = GEngine->OnLevelActorAdded().AddUObject(this, &AOrbitDebug::OnActorChanged);
+		LevelActorDeletedHandle = GEngine->OnLevelActorDeleted().AddUObject(this, &AOrbitDebug::OnActorChanged);
+	}
+}
+
+void AOrbitDebug::PostUnregisterAllComponents()
+{
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(ObjectPropertyChangedHandle);
+	ObjectPropertyChangedHandle.Reset();
+	if (GEngine)
+	{
+		GEngine->OnActorMoved().Remove(ActorMovedHandle);
+		GEngine->OnLevelActorAdded().Remove(LevelActorAddedHandle);
+		GEngine->OnLevelActorDeleted().Remove(LevelActorDeletedHandle);
+	}
+	ActorMovedHandle.Reset();
+	LevelActorAddedHandle.Reset();
+	LevelActorDeletedHandle.Reset();
+
+	Super::PostUnregisterAllComponents();
+}
+
+void AOrbitDebug::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	if (IsPredictionInput(Object)) UpdateOrbitChanged(true);
+}
+
+void AOrbitDebug::OnActorChanged(AActor* Actor)
+{
+	if (IsPredictionInput(Actor)) UpdateOrbitChanged(true);
+}
+
+bool AOrbitDebug::IsPredictionInput(const UObject* Object) const
+{
+	if (Object == this || Cast<ACelestialBody>(Object)) return true;
+
+	// A transform typed into the details panel is a property of the root component
+	const UActorComponent* Component = Cast<UActorComponent>(Object);
+	return Component && Cast<ACelestialBody>(Component->GetOwner());
+}
+#endif
+
 void AOrbitDebug::RunOrbitDebugger()
 {
+	SCOPE_CYCLE_COUNTER(STAT_RunOrbitDebugger);
+	
 	if (bOrbitChanged)
 	{
 		SimulateOrbits();
 		bOrbitChanged = false;
 	}
+	AdvancePrediction();
+	UpdatePathLod();
 
-	if (bDrawOrbitPaths) DrawDebugPaths();
+	bDrawOrbitPaths ? DrawDebugPaths() : OrbitDrawComponent->ClearPaths();
 	bDrawSplines ? DrawSplinePaths() : DeactivateSplineDebugDraw();
 }
 
 void AOrbitDebug::SimulateOrbits()
 {
 	if (!GetAllCelestialBodies()) return;
-	if (!SetPoints()) return;
+	if (Bodies.Num() == 0) return;
 	InitializeVirtualBodies();
-	CalculateOrbits();
+	
+	const FOrbitPredictionSettings Settings = GetPredictionSettings();
+	const uint64 NewPredictionKey = FOrbitPathCache::MakeKey(VirtualBodies, Settings);
+	
+	// Edits that change none of the inputs, like a rotated body or a new line color, keep the current paths. A new
+	// prediction running in the background takes the colors over when it is swapped in.
+	const bool bNewPredictionPending = PendingPrediction.IsValid() && !bPendingExtension;
+	if (NewPredictionKey == PredictionKey && (bNewPredictionPending || Predictor.GetPaths().NumBodies() == VirtualBodies.Num()))
+	{
+		if (Predictor.GetPaths().NumBodies() == VirtualBodies.Num())
+		{
+			Predictor.SetLineColors(VirtualBodies);
+		}
+		return;
+	}
+	
+	CancelPendingPrediction();
+	PredictionKey = NewPredictionKey;
+	PathCache.SetPersistent(bPersistPathCache);
+	
+	// The drawn paths are only replaced once the new ones are ready. Cached paths are ready right away and the
+	// game thread builds new paths up over several frames, only the task graph computes them in the background.
+	FOrbitPredictor NewPredictor;
+	const FCachedOrbitPaths* CachedPaths = bCachePaths ? PathCache.Find(PredictionKey, VirtualBodies.Num()) : nullptr;
+	if (CachedPaths)
+	{
+		NewPredictor.Restore(VirtualBodies, Settings, CachedPaths->Points, CachedPaths->NumSteps);
+	}
+	else
+	{
+		NewPredictor.Reset(VirtualBodies, Settings);
+	}
+	
+	if (!CachedPaths && bUseTaskGraph)
+	{
+		StartPendingPrediction(MoveTemp(NewPredictor), GetNumSteps(), false);
+	}
+	else
+	{
+		Predictor = MoveTemp(NewPredictor);
+	}
+}
+
+FOrbitPredictionSettings AOrbitDebug::GetPredictionSettings() const
+{
+	FOrbitPredictionSettings Settings;
+	Settings.TimeStep = GetTimeStep();
+	Settings.Simulation.Integrator = ToCore(GetIntegrator());
+	Settings.Simulation.GravitySolver = ToCore(GetGravitySolver());
+	Settings.Simulation.OpeningAngle = GetOpeningAngle();
+	Settings.Simulation.SofteningLength = GetSofteningLength();
+	Settings.Simulation.MaxTimestepLevel = GetMaxTimestepLevel();
+	Settings.Simulation.TimestepAccuracy = GetTimestepAccuracy();
+	Settings.Simulation.bDoublePrecision = GetDoublePrecision();
+	Settings.Simulation.bFloatingOrigin = GetFloatingOrigin();
+	return Settings;
 }
 
 bool AOrbitDebug::GetAllCelestialBodies()
@@ -50,13 +180,6 @@ bool AOrbitDebug::GetAllCelestialBodies()
 	return true;
 }
 
-bool AOrbitDebug::SetPoints()
-{
-	if (Bodies.Num() == 0) return false;
-	Points.SetNum(Bodies.Num() * GetNumSteps());
-	return true;
-}
-
 void AOrbitDebug::InitializeVirtualBodies()
 {
 	VirtualBodies.Empty();
@@ -69,129 +192,138 @@ void AOrbitDebug::InitializeVirtualBodies()
 			VirtualBodies.Add(FVirtualBody(Body));
 		}
 	}
+	
+	// The predictor expects the massless tracers after all bodies with mass
+	VirtualBodies.StableSort([](const FVirtualBody& A, const FVirtualBody& B) { return !A.bMasslessTracer && B.bMasslessTracer; });
 }
 
-void AOrbitDebug::CalculateOrbits() 
+/**
+ * Extends the predicted paths toward the current number of steps. With the task graph enabled the new steps are
+ * computed in the background and the current paths stay visible until they are done. Otherwise the prediction
+ * runs on the game thread, limited by the time budget per frame.
+ */
+void AOrbitDebug::AdvancePrediction()
 {
-	for (int Step = 0; Step < GetNumSteps(); ++Step)
+	SwapPendingPrediction();
+	if (PendingPrediction.IsValid()) return;
+	if (Predictor.GetNumSteps() >= GetNumSteps())
 	{
-		// UpdateVelocities();
-		// UpdatePositions(Step);
-		RungeKuttaIntegration(Step);
+		CachePredictedPaths();
+		return;
 	}
-}
-
-void AOrbitDebug::UpdateVelocities()
-{
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
+	
+	if (bUseTaskGraph)
 	{
-		VirtualBodies[i].Velocity += CalculateAcceleration(i) * GetTimeStep();
+		// The task only gets the state of the last step, the points it adds are appended when it is done
+		StartPendingPrediction(Predictor.MakeExtension(), GetNumSteps() - Predictor.GetNumSteps(), true);
 	}
-}
-
-void AOrbitDebug::UpdatePositions(const int& Step)
-{
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
+	else
 	{
-		VirtualBodies[i].Location += VirtualBodies[i].Velocity * GetTimeStep();
-		Points[i * GetNumSteps() + Step] = VirtualBodies[i].Location;
+		Predictor.Advance(GetNumSteps(), PredictionTimeBudget / 1000.0);
 	}
 }
 
-void AOrbitDebug::RungeKuttaIntegration(const int Step)
+void AOrbitDebug::StartPendingPrediction(FOrbitPredictor&& BackPredictor, const int TargetSteps, const bool bExtension)
 {
-	const float h = GetTimeStep();
-	TArray<FVector> NewPositions;
-	TArray<FVector> NewVelocities;
-	NewPositions.SetNum(VirtualBodies.Num());
-	NewVelocities.SetNum(VirtualBodies.Num());
-
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
-	{
-		FVector Position = VirtualBodies[i].Location;
-		FVector Velocity = VirtualBodies[i].Velocity;
-
-		FVector K1 = h * Velocity;
-		FVector L1 = h * CalculateAcceleration(i, Position);
-
-		FVector K2 = h * (Velocity + 0.5f * L1);
-		FVector L2 = h * CalculateAcceleration(i, Position + 0.5f * K1);
-
-		FVector K3 = h * (Velocity + 0.5f * L2);
-		FVector L3 = h * CalculateAcceleration(i, Position + 0.5f * K2);
-
-		FVector K4 = h * (Velocity + L3);
-		FVector L4 = h * CalculateAcceleration(i, Position + K3);
-
-		NewPositions[i] = Position + (K1 + 2.0f * K2 + 2.0f * K3 + K4) / 6.0f;
-		NewVelocities[i] = Velocity + (L1 + 2.0f * L2 + 2.0f * L3 + L4) / 6.0f;
-	}
+	PendingCancelFlag = MakeShared<FThreadSafeBool>(false);
+	bPendingExtension = bExtension;
+	PendingPrediction = Async(EAsyncExecution::TaskGraph,
+		[BackPredictor = MoveTemp(BackPredictor), TargetSteps, CancelFlag = PendingCancelFlag]() mutable
+		{
+			BackPredictor.Advance(TargetSteps, 0.0, CancelFlag.Get());
+			return MoveTemp(BackPredictor);
+		});
+}
 
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
+void AOrbitDebug::CancelPendingPrediction()
+{
+	if (PendingCancelFlag.IsValid())
 	{
-		VirtualBodies[i].Location = NewPositions[i];
-		VirtualBodies[i].Velocity = NewVelocities[i];
-		Points[i * GetNumSteps() + Step] = NewPositions[i];
+		// The task only holds its own predictor and the flag, so it can be left to finish on its own
+		*PendingCancelFlag = true;
+		PendingCancelFlag.Reset();
 	}
+	PendingPrediction = TFuture<FOrbitPredictor>();
 }
 
-void AOrbitDebug::DrawDebugPaths() const
+void AOrbitDebug::SwapPendingPrediction()
 {
-	const int NumBodies = VirtualBodies.Num();
-	const int Steps = GetNumSteps();
-	const float Thickness = GetLineThickness();
+	if (!PendingPrediction.IsValid() || !PendingPrediction.IsReady()) return;
 	
-	if (bDrawSplines)
+	if (bPendingExtension)
 	{
-		for (int i = 0; i < NumBodies; ++i)
-		{
-			for (int j = 1; j < Steps; ++j)
-			{
-				FVector Start = Points[i * Steps + (j - 1)];
-				FVector End = Points[i * Steps + j];
-				if (!Start.IsZero() && !End.IsZero())
-				{
-					FColor LineColor = VirtualBodies[i].LineColor.ToFColor(true);
-					DrawDebugLine(GetWorld(), Start, End, LineColor, false, -1.0f, 0, Thickness);
-				}
-			}
-		}
+		Predictor.Append(PendingPrediction.Consume());
 	}
 	else
 	{
-		for (int i = 0; i < NumBodies; ++i)
+		Predictor = PendingPrediction.Consume();
+		// The colors may have been edited while the prediction was running
+		if (Predictor.GetPaths().NumBodies() == VirtualBodies.Num())
 		{
-			for (int j = 1; j < Steps; ++j)
-			{
-				FVector Point = Points[i * Steps + j];
-				if (!Point.IsZero())
-				{
-					FColor LineColor = VirtualBodies[i].LineColor.ToFColor(true);
-					DrawDebugPoint(GetWorld(), Point, Thickness, LineColor, false, -1.0f);
-				}
-			}
+			Predictor.SetLineColors(VirtualBodies);
 		}
 	}
+	PendingCancelFlag.Reset();
+}
+
+void AOrbitDebug::CachePredictedPaths()
+{
+	if (!bCachePaths) return;
+	
+	// The cache ignores paths that are not longer than the ones it has, so this is cheap once they are stored
+	PathCache.SetPersistent(bPersistPathCache);
+	PathCache.Add(PredictionKey, Predictor.GetPaths());
+}
+
+int AOrbitDebug::GetNumDrawnSteps() const
+{
+	// The paths may be longer than requested after the number of steps was reduced, or shorter while they are extended
+	return FMath::Clamp(GetNumSteps(), 0, Predictor.GetNumSteps());
+}
+
+void AOrbitDebug::UpdatePathLod()
+{
+	// The camera of the last rendered frame, in the editor as in the game
+	const UWorld* World = GetWorld();
+	const FVector* ViewLocation = World && World->ViewLocationsRenderedLastFrame.Num() > 0 ? &World->ViewLocationsRenderedLastFrame[0] : nullptr;
+	PathLod.Update(Predictor.GetPaths(), GetNumDrawnSteps(), ViewLocation, GetPathPixelError());
 }
 
+void AOrbitDebug::DrawDebugPaths() const
+{
+	// Next to the splines the paths are drawn as lines, on their own as points
+	OrbitDrawComponent->DrawPaths(PathLod, Predictor.GetPaths().LineColors, GetLineThickness(), bDrawSplines);
+}
+
+/**
+ * Rebuilds the splines only when the drawn paths changed. Otherwise they keep their points from the last rebuild.
+ */
 void AOrbitDebug::DrawSplinePaths()
 {
-	ClearSplinePoints();
+	if (bSplinesDrawn && SplineRevision == PathLod.Revision) return;
+	
+	SCOPE_CYCLE_COUNTER(STAT_RebuildSplines);
+	INC_DWORD_STAT(STAT_SplineRebuilds);
 	AddSplineComponents();
 	AddSegmentPoints();
+	ClearSplinePoints(PathLod.NumBodies());
+	
+	SplineRevision = PathLod.Revision;
+	bSplinesDrawn = true;
 }
 
-void AOrbitDebug::ClearSplinePoints()
+void AOrbitDebug::ClearSplinePoints(const int FirstSpline)
 {
-	for (auto* Spline : SplineComponents)
+	for (int i = FirstSpline; i < SplineComponents.Num(); ++i)
 	{
-		Spline->ClearSplinePoints(false);
+		SplineComponents[i]->ClearSplinePoints(true);
+		SplineComponents[i]->SetDrawDebug(false);
 	}
 }
 
 void AOrbitDebug::AddSplineComponents()
 {
-	while (SplineComponents.Num() < VirtualBodies.Num())
+	while (SplineComponents.Num() < Predictor.GetPaths().NumBodies())
 	{
 		USplineComponent* NewSpline = NewObject<USplineComponent>(this, USplineComponent::StaticClass());
 		NewSpline->RegisterComponentWithWorld(GetWorld());
@@ -203,69 +335,25 @@ void AOrbitDebug::AddSplineComponents()
 
 void AOrbitDebug::AddSegmentPoints()
 {
-	const int Steps = GetNumSteps();
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
+	const FOrbitPaths& Paths = Predictor.GetPaths();
+	for (int i = 0; i < PathLod.NumBodies(); ++i)
 	{
 		USplineComponent* Spline = SplineComponents[i];
 
-		for (int Step = 0; Step < Steps; ++Step)
-		{
-
-			FVector Point = Points[i * Steps + Step];
-			if (Point.ContainsNaN())
-			{
-				LOG_WARNING_F("Point contains NaN: %s", *Point.ToString());
-				continue;
-			}
-
-			Spline->AddSplinePoint(Point, ESplineCoordinateSpace::World, false);
-			Spline->SetSplinePointType(Spline->GetNumberOfSplinePoints() - 1, ESplinePointType::Curve, false);
-		}
-		
-		Spline->UpdateSpline();
+		// One call replaces all points and updates the spline once, the simplified points are already free of NaN.
+		// The points get the curve type, like single added points.
+		const TConstArrayView<FVector> Polyline = PathLod.GetPolyline(i);
+		SplinePoints.Reset(Polyline.Num());
+		SplinePoints.Append(Polyline.GetData(), Polyline.Num());
+		Spline->SetSplinePoints(SplinePoints, ESplineCoordinateSpace::World, true);
+		INC_DWORD_STAT_BY(STAT_RebuiltSplinePoints, SplinePoints.Num());
 		
 		Spline->SetDrawDebug(true);
-		Spline->SetSelectedSplineSegmentColor(VirtualBodies[i].LineColor);
-		Spline->SetUnselectedSplineSegmentColor(VirtualBodies[i].LineColor);
+		Spline->SetSelectedSplineSegmentColor(Paths.LineColors[i]);
+		Spline->SetUnselectedSplineSegmentColor(Paths.LineColors[i]);
 	}
 }
 
-FVector AOrbitDebug::CalculateAcceleration(const int& BodyIndex) const
-{
-	FVector Acceleration = FVector::ZeroVector;
-
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
-	{
-		if(BodyIndex != i)
-		{
-			const FVector Direction = VirtualBodies[i].Location - VirtualBodies[BodyIndex].Location;
-			const float Distance = FVector::Dist(VirtualBodies[i].Location, VirtualBodies[BodyIndex].Location);
-			const float DistanceSquared = Distance * Distance;
-			Acceleration += Direction.GetSafeNormal() * (FUniverse::GravitationalConstant * VirtualBodies[i].Mass) / DistanceSquared;
-		}
-	}
-	
-	return Acceleration;
-}
-
-FVector AOrbitDebug::CalculateAcceleration(const int BodyIndex, const FVector& TempPosition) const
-{
-	FVector Acceleration = FVector::ZeroVector;
-    
-	for (int i = 0; i < VirtualBodies.Num(); ++i)
-	{
-		if (i != BodyIndex)
-		{
-			FVector Direction = VirtualBodies[i].Location - TempPosition;
-			float Distance = Direction.Size();
-			Direction.Normalize();
-			Acceleration += (FUniverse::GravitationalConstant * VirtualBodies[i].Mass / (Distance * Distance)) * Direction;
-		}
-	}
-    
-	return Acceleration;
-}
-
 TArray<TWeakObjectPtr<ACelestialBody>> AOrbitDebug::ConvertToWeakObjectPtrArray(const TArray<AActor*>& ActorArray) const
 {
 	TArray<TWeakObjectPtr<ACelestialBody>> WeakPtrArray;
@@ -285,9 +373,12 @@ TArray<TWeakObjectPtr<ACelestialBody>> AOrbitDebug::ConvertToWeakObjectPtrArray(
 
 void AOrbitDebug::DeactivateSplineDebugDraw()
 {
+	if (!bSplinesDrawn) return;
+	
 	for (auto* Spline : SplineComponents)
 	{
 		Spline->SetDrawDebug(false);
 	}
+	bSplinesDrawn = false;
 }
 
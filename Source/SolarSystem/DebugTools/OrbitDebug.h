@@ -6,8 +6,13 @@
 #include "FVirtualBody.h"
 #include "IVirtualBody.h"
 #include "OrbitDrawComponent.h"
+#include "OrbitPathCache.h"
+#include "OrbitPathLod.h"
+#include "OrbitPredictor.h"
 #include "Components/SplineComponent.h"
 #include "GameFramework/Actor.h"
+#include "SolarSystem/Structs/GravitySolver.h"
+#include "SolarSystem/Structs/OrbitIntegrator.h"
 #include "OrbitDebug.generated.h"
 
 /**
@@ -21,6 +26,13 @@ class SOLARSYSTEM_API AOrbitDebug : public AActor, public IVirtualBody
 protected:
 	AOrbitDebug();
 
+	virtual void Destroyed() override;
+
+#if WITH_EDITOR
+	virtual void PostRegisterAllComponents() override;
+	virtual void PostUnregisterAllComponents() override;
+#endif
+
 	UPROPERTY(VisibleAnywhere)
 	USceneComponent* Root;
 	
@@ -45,25 +57,113 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
 	float TimeStep = 500.0f;
 
+	// Plummer softening length. Removes the singularity when two bodies get close, 0 disables softening.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0.0"))
+	float SofteningLength = 0.0f;
+
+	// Choose the same integrator and gravity solver as the orbit simulation for a prediction that matches the game.
+	// The defaults are the same in both.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
+	EOrbitIntegrator Integrator = EOrbitIntegrator::VelocityVerlet;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
+	EGravitySolver GravitySolver = EGravitySolver::DirectSum;
+
+	// Barnes-Hut opening angle theta. Smaller values are more accurate, 0 equals the direct sum.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0.0", ClampMax = "2.0", EditCondition = "GravitySolver == EGravitySolver::BarnesHut"))
+	float OpeningAngle = 0.5f;
+
+	// Deepest level of the adaptive block timesteps. A body on level L takes 2^L substeps per predicted step. Every
+	// substep evaluates the bodies that end one, with Barnes-Hut it refits the tree, and once per step the tree is rebuilt.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0", ClampMax = "16", EditCondition = "Integrator == EOrbitIntegrator::AdaptiveBlockLeapfrog"))
+	int MaxTimestepLevel = 6;
+
+	// Distance a body may fall freely within one of its substeps.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0.001", EditCondition = "Integrator == EOrbitIntegrator::AdaptiveBlockLeapfrog"))
+	float TimestepAccuracy = 10.0f;
+
+	// Predicts in double precision, like the orbit simulation with the same option.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
+	bool bDoublePrecision = false;
+
+	// Keeps the heaviest body at the origin of the prediction.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
+	bool bFloatingOrigin = false;
+
+	// Deviation in pixels the drawn paths and splines may have from the predicted points. Paths far from the camera
+	// keep fewer points. 0 draws every point.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0.0"))
+	float PathPixelError = 1.0f;
+
+	// Time in milliseconds the prediction may take per frame when it runs on the game thread, 0 for no limit.
+	// Long predictions are spread over several frames.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (ClampMin = "0.0"))
+	float PredictionTimeBudget = 8.0f;
+
+	// Reuses the paths of initial conditions that were already predicted instead of integrating them again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug")
+	bool bCachePaths = true;
+
+	// Keeps the cached paths in Saved/OrbitPaths, so reopening a level shows the orbits right away.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Orbit Debug", meta = (EditCondition = "bCachePaths"))
+	bool bPersistPathCache = false;
+
 public:
 	
 #pragma region Getters and Setters
 	
 	virtual bool GetDrawOrbitPaths() const override { return bDrawOrbitPaths; }
-	void SetDrawOrbitPaths(const bool& bNewDrawOrbitPaths) { bDrawOrbitPaths = bNewDrawOrbitPaths; UpdateOrbitChanged(true); }
+	void SetDrawOrbitPaths(const bool& bNewDrawOrbitPaths) { bDrawOrbitPaths = bNewDrawOrbitPaths; }
 
 	bool GetDrawSplines() const { return bDrawSplines; }
-	void SetDrawSplines(const bool& bNewDrawSplines) { bDrawSplines = bNewDrawSplines; UpdateOrbitChanged(true); }
+	void SetDrawSplines(const bool& bNewDrawSplines) { bDrawSplines = bNewDrawSplines; }
 	
 	float GetLineThickness() const { return LineThickness; }
-	void SetLineThickness(const float& NewLineThickness) { LineThickness = NewLineThickness; UpdateOrbitChanged(true); }
+	void SetLineThickness(const float& NewLineThickness) { LineThickness = NewLineThickness; }
+
+	float GetPathPixelError() const { return PathPixelError; }
+	void SetPathPixelError(const float& NewPathPixelError) { PathPixelError = NewPathPixelError; }
 
 	int GetNumSteps() const { return NumSteps; }
-	void SetNumSteps(const int& NewNumSteps) { NumSteps = NewNumSteps; UpdateOrbitChanged(true); }
+	// Extends or shortens the current paths instead of predicting them again
+	void SetNumSteps(const int& NewNumSteps) { NumSteps = NewNumSteps; }
 
 	float GetTimeStep() const { return TimeStep; }
 	void SetTimeStep(const float& NewTimeStep) { TimeStep = NewTimeStep; UpdateOrbitChanged(true); }
 
+	float GetSofteningLength() const { return SofteningLength; }
+	void SetSofteningLength(const float& NewSofteningLength) { SofteningLength = NewSofteningLength; UpdateOrbitChanged(true); }
+
+	EOrbitIntegrator GetIntegrator() const { return Integrator; }
+	void SetIntegrator(const EOrbitIntegrator& NewIntegrator) { Integrator = NewIntegrator; UpdateOrbitChanged(true); }
+
+	EGravitySolver GetGravitySolver() const { return GravitySolver; }
+	void SetGravitySolver(const EGravitySolver& NewGravitySolver) { GravitySolver = NewGravitySolver; UpdateOrbitChanged(true); }
+
+	float GetOpeningAngle() const { return OpeningAngle; }
+	void SetOpeningAngle(const float& NewOpeningAngle) { OpeningAngle = NewOpeningAngle; UpdateOrbitChanged(true); }
+
+	int GetMaxTimestepLevel() const { return MaxTimestepLevel; }
+	void SetMaxTimestepLevel(const int& NewMaxTimestepLevel) { MaxTimestepLevel = NewMaxTimestepLevel; UpdateOrbitChanged(true); }
+
+	float GetTimestepAccuracy() const { return TimestepAccuracy; }
+	void SetTimestepAccuracy(const float& NewTimestepAccuracy) { TimestepAccuracy = NewTimestepAccuracy; UpdateOrbitChanged(true); }
+
+	bool GetDoublePrecision() const { return bDoublePrecision; }
+	void SetDoublePrecision(const bool& bNewDoublePrecision) { bDoublePrecision = bNewDoublePrecision; UpdateOrbitChanged(true); }
+
+	bool GetFloatingOrigin() const { return bFloatingOrigin; }
+	void SetFloatingOrigin(const bool& bNewFloatingOrigin) { bFloatingOrigin = bNewFloatingOrigin; UpdateOrbitChanged(true); }
+
+	bool GetCachePaths() const { return bCachePaths; }
+	void SetCachePaths(const bool& bNewCachePaths) { bCachePaths = bNewCachePaths; }
+
+	bool GetPersistPathCache() const { return bPersistPathCache; }
+	void SetPersistPathCache(const bool& bNewPersistPathCache) { bPersistPathCache = bNewPersistPathCache; }
+
+	bool GetUseTaskGraph() const { return bUseTaskGraph; }
+	void SetUseTaskGraph(const bool& bNewUseTaskGraph) { bUseTaskGraph = bNewUseTaskGraph; }
+
 	void UpdateOrbitChanged(const bool& bNewHasChanged) { bOrbitChanged = bNewHasChanged; }
 
 #pragma endregion
@@ -77,25 +177,53 @@ private:
 	TArray<TWeakObjectPtr<ACelestialBody>> Bodies;
 	
 	TArray<FVirtualBody> VirtualBodies;
-	TArray<FVector> Points;
 	bool bOrbitChanged = true;
 
+	// The prediction whose paths are drawn
+	FOrbitPredictor Predictor;
+	// A new prediction, or an extension of the drawn one, computed in the background with the task graph
+	TFuture<FOrbitPredictor> PendingPrediction;
+	TSharedPtr<FThreadSafeBool> PendingCancelFlag;
+	bool bPendingExtension = false;
+
+	// The simplified paths that are drawn
+	FOrbitPathLod PathLod;
+	// Revision of the simplified paths the splines show, and the reused point buffer of the rebuild
+	uint32 SplineRevision = 0;
+	bool bSplinesDrawn = false;
+	TArray<FVector> SplinePoints;
+	FOrbitPathCache PathCache;
+	// Cache key of the current prediction
+	uint64 PredictionKey = 0;
+
 	void SimulateOrbits();
-	bool SetPoints();
 	bool GetAllCelestialBodies();
 	void InitializeVirtualBodies();
+	FOrbitPredictionSettings GetPredictionSettings() const;
 	
-	void CalculateOrbits();
-	void UpdateVelocities();
-	void UpdatePositions(const int& Step);
-	void RungeKuttaIntegration(int Step);
+	void AdvancePrediction();
+	void StartPendingPrediction(FOrbitPredictor&& BackPredictor, const int TargetSteps, const bool bExtension);
+	void CancelPendingPrediction();
+	void SwapPendingPrediction();
+	void CachePredictedPaths();
+
+#if WITH_EDITOR
+	FDelegateHandle ObjectPropertyChangedHandle;
+	FDelegateHandle ActorMovedHandle;
+	FDelegateHandle LevelActorAddedHandle;
+	FDelegateHandle LevelActorDeletedHandle;
+
+	void OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent);
+	void OnActorChanged(AActor* Actor);
+	bool IsPredictionInput(const UObject* Object) const;
+#endif
+	int GetNumDrawnSteps() const;
+	void UpdatePathLod();
 	
-	FVector CalculateAcceleration(int BodyIndex, const FVector& TempPosition) const;
-	FVector CalculateAcceleration(const int& BodyIndex) const;
 	void DrawDebugPaths() const;
 	void AddSplineComponents();
 	void AddSegmentPoints();
-	void ClearSplinePoints();
+	void ClearSplinePoints(const int FirstSpline);
 	void DrawSplinePaths();
 	
 
@@ -3,6 +3,8 @@
 
 #include "OrbitDrawComponent.h"
 
+#include "Components/LineBatchComponent.h"
+
 UOrbitDrawComponent::UOrbitDrawComponent() : OrbitDrawer(Cast<IVirtualBody>(GetOwner()))
 {
 	PrimaryComponentTick.bCanEverTick = true;
@@ -24,4 +26,80 @@ void UOrbitDrawComponent::DrawOrbits() const
 	}
 }
 
+void UOrbitDrawComponent::DrawPaths(const FOrbitPathLod& Paths, const TArray<FLinearColor>& LineColors, const float Thickness,
+	const bool bAsLines)
+{
+	if (bHasDrawnPaths && Paths.Revision == DrawnRevision && Thickness == DrawnThickness && bAsLines == bDrawnAsLines) return;
+	
+	ULineBatchComponent* Batcher = GetPathBatcher();
+	if (!Batcher) return;
+	
+	Batcher->Flush();
+	if (bAsLines)
+	{
+		TArray<FBatchedLine> Lines;
+		Lines.Reserve(Paths.Points.Num());
+		for (int i = 0; i < Paths.NumBodies(); ++i)
+		{
+			const TConstArrayView<FVector> Polyline = Paths.GetPolyline(i);
+			for (int j = 1; j < Polyline.Num(); ++j)
+			{
+				Lines.Emplace(Polyline[j - 1], Polyline[j], LineColors[i], 0.0f, Thickness, SDPG_World);
+			}
+		}
+		Batcher->DrawLines(Lines);
+	}
+	else
+	{
+		TArray<FBatchedPoint>& Points = Batcher->BatchedPoints;
+		Points.Reserve(Paths.Points.Num());
+		for (int i = 0; i < Paths.NumBodies(); ++i)
+		{
+			for (const FVector& Point : Paths.GetPolyline(i))
+			{
+				Points.Emplace(Point, LineColors[i], Thickness, 0.0f, SDPG_World);
+			}
+		}
+		Batcher->MarkRenderStateDirty();
+	}
+	
+	DrawnRevision = Paths.Revision;
+	DrawnThickness = Thickness;
+	bDrawnAsLines = bAsLines;
+	bHasDrawnPaths = true;
+}
 
+void UOrbitDrawComponent::ClearPaths()
+{
+	if (!bHasDrawnPaths) return;
+	
+	if (PathBatcher)
+	{
+		PathBatcher->Flush();
+	}
+	bHasDrawnPaths = false;
+}
+
+void UOrbitDrawComponent::OnUnregister()
+{
+	if (PathBatcher)
+	{
+		PathBatcher->DestroyComponent();
+		PathBatcher = nullptr;
+	}
+	bHasDrawnPaths = false;
+	
+	Super::OnUnregister();
+}
+
+ULineBatchComponent* UOrbitDrawComponent::GetPathBatcher()
+{
+	if (!PathBatcher && GetWorld())
+	{
+		PathBatcher = NewObject<ULineBatchComponent>(GetOwner(), NAME_None, RF_Transient);
+		// The lines never expire, so the batch has nothing to do per tick
+		PathBatcher->PrimaryComponentTick.bCanEverTick = false;
+		PathBatcher->RegisterComponentWithWorld(GetWorld());
+	}
+	return PathBatcher;
+}
@@ -4,9 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "IVirtualBody.h"
+#include "OrbitPathLod.h"
 #include "Components/ActorComponent.h"
 #include "OrbitDrawComponent.generated.h"
 
+class ULineBatchComponent;
+
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class SOLARSYSTEM_API UOrbitDrawComponent : public USceneComponent
@@ -16,10 +19,30 @@ class SOLARSYSTEM_API UOrbitDrawComponent : public USceneComponent
 public:
 	UOrbitDrawComponent();
 
+	/**
+	 * Shows the simplified paths as one batch of lines or points. The batch is only rebuilt when the paths or
+	 * the parameters changed, in between the vertices stay on the GPU and no draw call is issued per segment.
+	 */
+	void DrawPaths(const FOrbitPathLod& Paths, const TArray<FLinearColor>& LineColors, const float Thickness, const bool bAsLines);
+	void ClearPaths();
+
+protected:
+	virtual void OnUnregister() override;
+
 private:
 	IVirtualBody* OrbitDrawer = nullptr;
+
+	UPROPERTY(Transient)
+	ULineBatchComponent* PathBatcher = nullptr;
+
+	// What the batch currently shows, no steps while it is empty
+	uint32 DrawnRevision = 0;
+	bool bHasDrawnPaths = false;
+	float DrawnThickness = 0.0f;
+	bool bDrawnAsLines = false;
 	
 	void DrawOrbits() const;
+	ULineBatchComponent* GetPathBatcher();
 	
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType,
 								FActorComponentTickFunction* ThisTickFunction) override;
@@ -0,0 +1,176 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#include "OrbitPathCache.h"
+
+#include "HAL/FileManager.h"
+#include "Hash/xxhash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "SolarSystem/Defines/Debug.h"
+
+// Changes whenever the key or the file format changes, so stale files are never mistaken for current ones
+static constexpr int32 OrbitPathCacheVersion = 3;
+
+template <typename ValueType>
+static void HashValue(FXxHash64Builder& Builder, const ValueType& Value)
+{
+	Builder.Update(&Value, sizeof(Value));
+}
+
+uint64 FOrbitPathCache::MakeKey(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& Settings)
+{
+	// The members are hashed one by one, the padding of the structs is undefined
+	FXxHash64Builder Builder;
+	HashValue(Builder, OrbitPathCacheVersion);
+	HashValue(Builder, VirtualBodies.Num());
+	for (const FVirtualBody& Body : VirtualBodies)
+	{
+		HashValue(Builder, Body.Mass);
+		HashValue(Builder, Body.Location);
+		HashValue(Builder, Body.Velocity);
+		HashValue(Builder, Body.bMasslessTracer);
+	}
+
+	const FOrbitSimulationSettings& Simulation = Settings.Simulation;
+	HashValue(Builder, Settings.TimeStep);
+	HashValue(Builder, Simulation.Integrator);
+	HashValue(Builder, Simulation.GravitySolver);
+	HashValue(Builder, Simulation.OpeningAngle);
+	HashValue(Builder, Simulation.SofteningLength);
+	HashValue(Builder, Simulation.MaxTimestepLevel);
+	HashValue(Builder, Simulation.TimestepAccuracy);
+	HashValue(Builder, Simulation.bDoublePrecision);
+	HashValue(Builder, Simulation.bFloatingOrigin);
+	return Builder.Finalize().Hash;
+}
+
+const FCachedOrbitPaths* FOrbitPathCache::Find(const uint64 Key, const int NumBodies)
+{
+	if (!Entries.Contains(Key))
+	{
+		FCachedOrbitPaths Paths;
+		if (!bPersistent || !LoadPaths(Key, NumBodies, Paths)) return nullptr;
+
+		Entries.Add(Key, MoveTemp(Paths));
+	}
+
+	Touch(Key);
+	return Entries.Find(Key);
+}
+
+void FOrbitPathCache::Add(const uint64 Key, const FOrbitPaths& Paths)
+{
+	const FCachedOrbitPaths* Existing = Entries.Find(Key);
+	if (Existing && Existing->NumSteps >= Paths.NumSteps) return;
+
+	FCachedOrbitPaths& Entry = Entries.Add(Key);
+	Entry.Points = Paths.Points;
+	Entry.NumSteps = Paths.NumSteps;
+	Touch(Key);
+
+	if (bPersistent && SavePaths(Key, Entry))
+	{
+		PruneFiles();
+	}
+}
+
+void FOrbitPathCache::Touch(const uint64 Key)
+{
+	RecentKeys.Remove(Key);
+	RecentKeys.Add(Key);
+
+	while (RecentKeys.Num() > MaxEntries)
+	{
+		Entries.Remove(RecentKeys[0]);
+		RecentKeys.RemoveAt(0);
+	}
+}
+
+FString FOrbitPathCache::GetDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("OrbitPaths");
+}
+
+FString FOrbitPathCache::GetFilePath(const uint64 Key)
+{
+	return GetDirectory() / FString::Printf(TEXT("%016llx.bin"), Key);
+}
+
+/**
+ * Reads the paths of the key from disk. Files of another version, truncated files and files whose points do not
+ * fit the bodies are deleted, so a stale or edited file never reaches the predictor.
+ */
+bool FOrbitPathCache::LoadPaths(const uint64 Key, const int NumBodies, FCachedOrbitPaths& OutPaths)
+{
+	const FString Path = GetFilePath(Key);
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Path, FILEREAD_Silent)) return false;
+
+	FMemoryReader Reader(Data);
+	int32 Version = 0;
+	uint64 FileKey = 0;
+	Reader << Version << FileKey;
+	if (Version == OrbitPathCacheVersion && FileKey == Key)
+	{
+		Reader << OutPaths.NumSteps << OutPaths.Points;
+	}
+
+	const bool bValid = !Reader.IsError() && Version == OrbitPathCacheVersion && FileKey == Key
+		&& OutPaths.NumSteps >= 0 && OutPaths.Points.Num() == OutPaths.NumSteps * NumBodies;
+	if (!bValid)
+	{
+		LOG_WARNING_F("Deleted the invalid orbit path cache %s", *Path);
+		IFileManager::Get().Delete(*Path, false, false, true);
+		return false;
+	}
+
+	// The modification time orders the files by their last use when they are pruned
+	IFileManager::Get().SetTimeStamp(*Path, FDateTime::UtcNow());
+	return true;
+}
+
+bool FOrbitPathCache::SavePaths(const uint64 Key, const FCachedOrbitPaths& Paths)
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	int32 Version = OrbitPathCacheVersion;
+	uint64 FileKey = Key;
+	int NumSteps = Paths.NumSteps;
+	Writer << Version << FileKey << NumSteps;
+	Writer << const_cast<TArray<FVector>&>(Paths.Points);
+
+	const FString Path = GetFilePath(Key);
+	if (!FFileHelper::SaveArrayToFile(Data, *Path))
+	{
+		LOG_WARNING_F("Failed to write the orbit path cache %s", *Path);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Deletes the least recently used files beyond the number of entries the cache keeps.
+ */
+void FOrbitPathCache::PruneFiles()
+{
+	IFileManager& FileManager = IFileManager::Get();
+	const FString Directory = GetDirectory();
+	TArray<FString> FileNames;
+	FileManager.FindFiles(FileNames, *(Directory / TEXT("*.bin")), true, false);
+	if (FileNames.Num() <= MaxEntries) return;
+
+	TArray<TPair<FDateTime, FString>> Files;
+	for (const FString& FileName : FileNames)
+	{
+		const FString Path = Directory / FileName;
+		Files.Emplace(FileManager.GetTimeStamp(*Path), Path);
+	}
+	Files.Sort([](const TPair<FDateTime, FString>& A, const TPair<FDateTime, FString>& B) { return A.Key > B.Key; });
+
+	for (int i = MaxEntries; i < Files.Num(); ++i)
+	{
+		FileManager.Delete(*Files[i].Value, false, false, true);
+	}
+}
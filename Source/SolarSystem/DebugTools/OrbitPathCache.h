@@ -0,0 +1,64 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FVirtualBody.h"
+#include "OrbitPredictor.h"
+
+/**
+ * The points of predicted paths as they are stored in the cache.
+ */
+struct FCachedOrbitPaths
+{
+	TArray<FVector> Points;
+	int NumSteps = 0;
+};
+
+/**
+ * Remembers the predicted paths of recent initial conditions, so a prediction that was already computed is shown
+ * again without integrating. The key covers everything that decides the trajectories, but not the number of steps:
+ * longer paths serve every shorter request. Optionally the paths are kept in Saved/OrbitPaths across sessions.
+ */
+class FOrbitPathCache
+{
+public:
+	/**
+	 * Hashes the initial conditions of the bodies and the prediction settings.
+	 */
+	static uint64 MakeKey(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& Settings);
+
+	/**
+	 * Looks the paths up in memory and, if the cache is persistent, on disk. A file whose points do not fit the
+	 * number of bodies is deleted.
+	 *
+	 * @param NumBodies The number of bodies the paths must have.
+	 * @return const FCachedOrbitPaths* The cached paths or nullptr. Valid until the next call that changes the cache.
+	 */
+	const FCachedOrbitPaths* Find(const uint64 Key, const int NumBodies);
+
+	/**
+	 * Stores the paths under the key, unless longer paths are already cached.
+	 */
+	void Add(const uint64 Key, const FOrbitPaths& Paths);
+
+	void Empty() { Entries.Empty(); RecentKeys.Empty(); }
+
+	bool IsPersistent() const { return bPersistent; }
+	void SetPersistent(const bool& bNewPersistent) { bPersistent = bNewPersistent; }
+
+private:
+	// Number of predictions kept in memory and on disk, the least recently used one is dropped first
+	static constexpr int MaxEntries = 16;
+
+	TMap<uint64, FCachedOrbitPaths> Entries;
+	TArray<uint64> RecentKeys;
+	bool bPersistent = false;
+
+	void Touch(const uint64 Key);
+	static FString GetDirectory();
+	static FString GetFilePath(const uint64 Key);
+	static bool LoadPaths(const uint64 Key, const int NumBodies, FCachedOrbitPaths& OutPaths);
+	static bool SavePaths(const uint64 Key, const FCachedOrbitPaths& Paths);
+	static void PruneFiles();
+};
@@ -0,0 +1,161 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#include "OrbitPathLod.h"
+
+// World units per pixel at a distance of one unit, for a 90 degree field of view across 1080 pixels
+static constexpr float UnitsPerPixelAndDistance = 2.0f / 1080.0f;
+// Smallest tolerance in world units, closer paths keep all their points anyway
+static constexpr float MinTolerance = 1.0f;
+
+// Points that were never computed are skipped, as the unsimplified drawing always did
+static bool IsDrawablePoint(const FVector& Point)
+{
+	return !Point.IsZero() && !Point.ContainsNaN();
+}
+
+bool FOrbitPathLod::Update(const FOrbitPaths& Paths, const int NumSteps, const FVector* ViewLocation, const float PixelError)
+{
+	const int BodyCount = Paths.NumBodies();
+	// New paths, not just new steps of the same ones, invalidate every chunk
+	if (Paths.Generation != SourceGeneration || BodyChunks.Num() != BodyCount)
+	{
+		BodyChunks.Reset();
+		BodyChunks.SetNum(BodyCount);
+		SourceGeneration = Paths.Generation;
+	}
+
+	// A new color changes the revision as well, then the polylines are only put together again
+	bool bChanged = Paths.Revision != SourceRevision || NumSteps != SourceSteps;
+	const int NumChunks = NumSteps > 1 ? FMath::DivideAndRoundUp(NumSteps - 1, ChunkSteps) : NumSteps;
+	for (int i = 0; i < BodyCount; ++i)
+	{
+		TArray<FChunk>& Chunks = BodyChunks[i];
+		Chunks.SetNum(NumChunks);
+		for (int ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+		{
+			FChunk& Chunk = Chunks[ChunkIndex];
+			const int FirstStep = ChunkIndex * ChunkSteps;
+			const int LastStep = FMath::Min(FirstStep + ChunkSteps, NumSteps - 1);
+			if (Chunk.LastStep != LastStep)
+			{
+				Chunk.LastStep = LastStep;
+				Chunk.Bounds = FBox(ForceInit);
+				for (int Step = FirstStep; Step <= LastStep; ++Step)
+				{
+					const FVector& Point = Paths.GetPoint(i, Step);
+					if (IsDrawablePoint(Point))
+					{
+						Chunk.Bounds += Point;
+					}
+				}
+				// No tolerance matches, so the chunk is simplified below
+				Chunk.Tolerance = -1.0f;
+			}
+
+			const float Tolerance = NumSteps < 3 ? 0.0f : CalculateTolerance(Chunk.Bounds, ViewLocation, PixelError);
+			if (Tolerance != Chunk.Tolerance)
+			{
+				Chunk.Tolerance = Tolerance;
+				Simplify(Paths, i, FirstStep, Chunk);
+				bChanged = true;
+			}
+		}
+	}
+
+	if (!bChanged) return false;
+
+	Points.Reset();
+	PolylineStarts.Reset(BodyCount + 1);
+	for (const TArray<FChunk>& Chunks : BodyChunks)
+	{
+		PolylineStarts.Add(Points.Num());
+		for (const FChunk& Chunk : Chunks)
+		{
+			Points.Append(Chunk.Points);
+		}
+	}
+	PolylineStarts.Add(Points.Num());
+
+	SourceRevision = Paths.Revision;
+	SourceSteps = NumSteps;
+	++Revision;
+	return true;
+}
+
+float FOrbitPathLod::CalculateTolerance(const FBox& Bounds, const FVector* ViewLocation, const float PixelError)
+{
+	if (!ViewLocation || PixelError <= 0.0f || !Bounds.IsValid) return 0.0f;
+
+	// The nearest part of the chunk decides, so no part of it is drawn coarser than allowed. A chunk is a short
+	// piece of the path, so the camera is rarely inside its bounds, unlike inside the bounds of a whole orbit.
+	const float Distance = FMath::Sqrt(Bounds.ComputeSquaredDistanceToPoint(*ViewLocation));
+	const float Tolerance = PixelError * UnitsPerPixelAndDistance * Distance;
+	if (Tolerance < MinTolerance) return 0.0f;
+
+	return FMath::Exp2(FMath::FloorToFloat(FMath::Log2(Tolerance)));
+}
+
+/**
+ * Douglas-Peucker: keeps the end points, then recursively the point farthest from the segment between the kept
+ * points, as long as it is farther away than the tolerance. Runs on an explicit stack, long paths would overflow
+ * the call stack.
+ */
+void FOrbitPathLod::Simplify(const FOrbitPaths& Paths, const int BodyIndex, const int FirstStep, FChunk& Chunk)
+{
+	Source.Reset();
+	// The chunk before ends with the boundary step if it is drawable, so it is not added twice
+	bool bSkipFirst = false;
+	for (int Step = FirstStep; Step <= Chunk.LastStep; ++Step)
+	{
+		const FVector& Point = Paths.GetPoint(BodyIndex, Step);
+		if (IsDrawablePoint(Point))
+		{
+			bSkipFirst |= Step == FirstStep && FirstStep > 0;
+			Source.Add(Point);
+		}
+	}
+
+	const int FirstKept = bSkipFirst ? 1 : 0;
+	Chunk.Points.Reset();
+	if (Chunk.Tolerance <= 0.0f || Source.Num() < 3)
+	{
+		Chunk.Points.Append(Source.GetData() + FirstKept, FMath::Max(Source.Num() - FirstKept, 0));
+		return;
+	}
+
+	Keep.Init(false, Source.Num());
+	Keep[0] = true;
+	Keep[Source.Num() - 1] = true;
+
+	const float SqrTolerance = Chunk.Tolerance * Chunk.Tolerance;
+	Ranges.Reset();
+	Ranges.Emplace(0, Source.Num() - 1);
+	while (Ranges.Num() > 0)
+	{
+		const TPair<int, int> Range = Ranges.Pop(false);
+
+		int Farthest = INDEX_NONE;
+		double MaxSqrDistance = SqrTolerance;
+		for (int i = Range.Key + 1; i < Range.Value; ++i)
+		{
+			const double SqrDistance = FMath::PointDistToSegmentSquared(Source[i], Source[Range.Key], Source[Range.Value]);
+			if (SqrDistance > MaxSqrDistance)
+			{
+				MaxSqrDistance = SqrDistance;
+				Farthest = i;
+			}
+		}
+
+		if (Farthest != INDEX_NONE)
+		{
+			Keep[Farthest] = true;
+			Ranges.Emplace(Range.Key, Farthest);
+			Ranges.Emplace(Farthest, Range.Value);
+		}
+	}
+
+	for (TConstSetBitIterator<> It(Keep, FirstKept); It; ++It)
+	{
+		Chunk.Points.Add(Source[It.GetIndex()]);
+	}
+}
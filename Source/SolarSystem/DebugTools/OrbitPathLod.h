@@ -0,0 +1,68 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OrbitPredictor.h"
+
+/**
+ * Simplified copies of the predicted paths, one polyline per body, that keep only the points needed for the
+ * allowed pixel error. A part of a path far from the camera may deviate more in world units than one next to it.
+ *
+ * Every path is simplified in chunks of a fixed number of steps, each with the tolerance of its own distance to
+ * the camera. A long orbit around the camera is thinned out along its whole length, and extending a path or
+ * moving the camera only simplifies the chunks that changed.
+ */
+struct FOrbitPathLod
+{
+	// The polylines of all bodies back to back, body i owns the points from PolylineStarts[i] to PolylineStarts[i + 1]
+	TArray<FVector> Points;
+	TArray<int> PolylineStarts;
+	// Changes whenever the polylines change
+	uint32 Revision = 0;
+
+	int NumBodies() const { return FMath::Max(PolylineStarts.Num() - 1, 0); }
+	TConstArrayView<FVector> GetPolyline(const int BodyIndex) const
+	{
+		return MakeArrayView(Points.GetData() + PolylineStarts[BodyIndex], PolylineStarts[BodyIndex + 1] - PolylineStarts[BodyIndex]);
+	}
+
+	/**
+	 * Simplifies the chunks of the first steps of the paths again that got new steps, or whose tolerance changed
+	 * because the camera moved far enough. The tolerances are rounded to powers of two, so small camera moves
+	 * keep the chunks.
+	 *
+	 * @param ViewLocation The camera the pixel error refers to, nullptr keeps every point.
+	 * @param PixelError The allowed deviation in pixels, 0 keeps every point.
+	 * @return bool True if the polylines changed.
+	 */
+	bool Update(const FOrbitPaths& Paths, const int NumSteps, const FVector* ViewLocation, const float PixelError);
+
+private:
+	// Steps per chunk. Neighboring chunks share their boundary step, so the polylines stay connected.
+	static constexpr int ChunkSteps = 64;
+
+	struct FChunk
+	{
+		// The last step the chunk was simplified up to
+		int LastStep = INDEX_NONE;
+		float Tolerance = 0.0f;
+		FBox Bounds = FBox(ForceInit);
+		// The simplified points, without the boundary step the chunk before already ends with
+		TArray<FVector> Points;
+	};
+
+	uint32 SourceGeneration = 0;
+	uint32 SourceRevision = 0;
+	int SourceSteps = INDEX_NONE;
+	// The chunks of every body
+	TArray<TArray<FChunk>> BodyChunks;
+
+	// Reused between the simplifications, so a frame does not allocate
+	TArray<FVector> Source;
+	TArray<TPair<int, int>> Ranges;
+	TBitArray<> Keep;
+
+	static float CalculateTolerance(const FBox& Bounds, const FVector* ViewLocation, const float PixelError);
+	void Simplify(const FOrbitPaths& Paths, const int BodyIndex, const int FirstStep, FChunk& Chunk);
+};
@@ -0,0 +1,128 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#include "OrbitPredictor.h"
+
+#include "Algo/Count.h"
+#include "Algo/MaxElement.h"
+#include "HAL/ThreadSafeCounter.h"
+
+// Predictors are reset on the game thread and on background tasks
+static FThreadSafeCounter NextPathsGeneration;
+
+void FOrbitPredictor::Reset(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& InSettings)
+{
+	Settings = InSettings;
+
+	Paths.NumSteps = 0;
+	Paths.Points.Reset();
+	Paths.LineColors.Reset(VirtualBodies.Num());
+	++Paths.Revision;
+	Paths.Generation = NextPathsGeneration.Increment();
+
+	Cores.Visit(Settings.Simulation.bDoublePrecision, [this, &VirtualBodies](auto& Core)
+	{
+		Core.Settings = Settings.Simulation;
+		Core.State.SetNum(VirtualBodies.Num());
+
+		const FVirtualBody* HeaviestBody = Algo::MaxElementBy(VirtualBodies, &FVirtualBody::Mass);
+		Core.Origin = Settings.Simulation.bFloatingOrigin && HeaviestBody ? HeaviestBody->Location : FVector::ZeroVector;
+		for (int i = 0; i < VirtualBodies.Num(); ++i)
+		{
+			Core.SetWorldPosition(i, VirtualBodies[i].Location);
+			Core.State.SetVelocity(i, VirtualBodies[i].Velocity);
+			Core.State.Mass[i] = VirtualBodies[i].Mass;
+			Paths.LineColors.Add(VirtualBodies[i].LineColor);
+		}
+		Core.State.NumSources = Algo::CountIf(VirtualBodies, [](const FVirtualBody& Body) { return !Body.bMasslessTracer; });
+		checkSlow(Core.State.NumSources == 0 || !VirtualBodies[Core.State.NumSources - 1].bMasslessTracer);
+		Core.Invalidate();
+	});
+	NumStateSteps = 0;
+}
+
+void FOrbitPredictor::Restore(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& InSettings,
+	const TArray<FVector>& KnownPoints, const int NumKnownSteps)
+{
+	Reset(VirtualBodies, InSettings);
+
+	check(KnownPoints.Num() == NumKnownSteps * VirtualBodies.Num());
+	Paths.Points = KnownPoints;
+	Paths.NumSteps = NumKnownSteps;
+	++Paths.Revision;
+}
+
+FOrbitPredictor FOrbitPredictor::MakeExtension() const
+{
+	FOrbitPredictor Extension;
+	Extension.Cores = Cores;
+	Extension.Settings = Settings;
+	Extension.Paths.LineColors = Paths.LineColors;
+	// A restored state may still be behind the end of the paths, then the extension starts with catching up
+	Extension.NumStateSteps = NumStateSteps - Paths.NumSteps;
+	return Extension;
+}
+
+void FOrbitPredictor::Append(FOrbitPredictor&& Extension)
+{
+	check(Extension.Paths.NumBodies() == Paths.NumBodies());
+	Cores = MoveTemp(Extension.Cores);
+	NumStateSteps = Paths.NumSteps + Extension.NumStateSteps;
+	
+	Paths.Points.Append(Extension.Paths.Points);
+	Paths.NumSteps += Extension.Paths.NumSteps;
+	++Paths.Revision;
+}
+
+void FOrbitPredictor::SetLineColors(const TArray<FVirtualBody>& VirtualBodies)
+{
+	check(VirtualBodies.Num() == Paths.NumBodies());
+	for (int i = 0; i < VirtualBodies.Num(); ++i)
+	{
+		Paths.LineColors[i] = VirtualBodies[i].LineColor;
+	}
+	++Paths.Revision;
+}
+
+bool FOrbitPredictor::Advance(const int TargetSteps, const double TimeBudget, const FThreadSafeBool* CancelFlag)
+{
+	if (Paths.NumBodies() == 0) return true;
+
+	const double EndTime = FPlatformTime::Seconds() + TimeBudget;
+	Paths.Points.Reserve(FMath::Max(TargetSteps, 0) * Paths.NumBodies());
+	const FVector* PointsData = Paths.Points.GetData();
+
+	while (Paths.NumSteps < TargetSteps)
+	{
+		if (CancelFlag && *CancelFlag) return false;
+
+		Step();
+
+		if (TimeBudget > 0.0 && FPlatformTime::Seconds() >= EndTime) break;
+	}
+
+	// The points are reserved up front, the scratch data of the cores after their first step, which the
+	// SolarSystem.Orbit.PredictorAllocations test checks
+	checkSlow(Paths.Points.GetData() == PointsData);
+
+	return Paths.NumSteps >= TargetSteps;
+}
+
+void FOrbitPredictor::Step()
+{
+	const bool bNewStep = ++NumStateSteps > Paths.NumSteps;
+	Cores.Visit(Settings.Simulation.bDoublePrecision, [this, bNewStep](auto& Core)
+	{
+		Core.Step(Settings.TimeStep);
+		if (!bNewStep) return;
+
+		for (int i = 0; i < Core.State.Num(); ++i)
+		{
+			Paths.Points.Add(Core.GetWorldPosition(i));
+		}
+	});
+	if (bNewStep)
+	{
+		++Paths.NumSteps;
+		++Paths.Revision;
+	}
+}
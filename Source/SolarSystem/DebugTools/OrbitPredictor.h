@@ -0,0 +1,104 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FVirtualBody.h"
+#include "HAL/ThreadSafeBool.h"
+#include "SolarSystem/Orbit/OrbitSimulationCore.h"
+#include "SolarSystem/Structs/OrbitState.h"
+
+/**
+ * The predicted orbit paths of all bodies. The points are stored step by step, one point per body each,
+ * so the paths can be extended without moving the points that are already computed.
+ */
+struct FOrbitPaths
+{
+	TArray<FVector> Points;
+	TArray<FLinearColor> LineColors;
+	int NumSteps = 0;
+	// Changes whenever the points or the colors change, so views of the paths know when to rebuild
+	uint32 Revision = 0;
+	// Changes whenever the points are replaced, unique across predictors, whose revisions may collide
+	uint32 Generation = 0;
+
+	int NumBodies() const { return LineColors.Num(); }
+	const FVector& GetPoint(const int BodyIndex, const int Step) const { return Points[Step * NumBodies() + BodyIndex]; }
+};
+
+/**
+ * The parameters that influence the predicted positions.
+ */
+struct FOrbitPredictionSettings
+{
+	float TimeStep = 0.0f;
+	// The same settings as in the runtime simulation give the same trajectories
+	FOrbitSimulationSettings Simulation;
+};
+
+/**
+ * Integrates a snapshot of virtual bodies ahead in time.
+ * It does not touch any actor, so the prediction can run on any thread. The predictor keeps the state of its
+ * last step, so the paths can be extended incrementally and spread over several frames.
+ */
+class FOrbitPredictor
+{
+public:
+	/**
+	 * Starts a new prediction and discards the current paths. The massless tracers must come after all
+	 * bodies with mass.
+	 */
+	void Reset(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& InSettings);
+
+	/**
+	 * Starts a prediction whose first steps are already known, e.g. from the path cache. The state stays at the
+	 * initial conditions and only catches up with the known points if the paths are extended beyond them.
+	 */
+	void Restore(const TArray<FVirtualBody>& VirtualBodies, const FOrbitPredictionSettings& InSettings,
+		const TArray<FVector>& KnownPoints, const int NumKnownSteps);
+
+	/**
+	 * Extends the paths until they reach the target number of steps or the time budget is used up.
+	 * At least one step is taken per call.
+	 *
+	 * @param TargetSteps The number of steps the paths should have.
+	 * @param TimeBudget The time in seconds the call may take, 0 for no limit.
+	 * @param CancelFlag Optional flag that aborts the prediction when it is raised.
+	 * @return bool True if the paths reached the target number of steps.
+	 */
+	bool Advance(const int TargetSteps, const double TimeBudget = 0.0, const FThreadSafeBool* CancelFlag = nullptr);
+
+	/**
+	 * Copies the state of the last step without the points, so the copy can extend the paths on another thread
+	 * without duplicating them. The paths of the copy only hold the steps it adds.
+	 */
+	FOrbitPredictor MakeExtension() const;
+
+	/**
+	 * Adds the steps of an extension made from this predictor and continues from its state.
+	 */
+	void Append(FOrbitPredictor&& Extension);
+
+	/**
+	 * Takes over the line colors of the bodies. The colors do not influence the paths.
+	 */
+	void SetLineColors(const TArray<FVirtualBody>& VirtualBodies);
+
+	const FOrbitPaths& GetPaths() const { return Paths; }
+	int GetNumSteps() const { return Paths.NumSteps; }
+	SIZE_T GetAllocatedSize() const
+	{
+		return Cores.GetAllocatedSize() + Paths.Points.GetAllocatedSize() + Paths.LineColors.GetAllocatedSize();
+	}
+
+private:
+	// Positions, velocities and masses of the virtual bodies at the last predicted step
+	FOrbitSimulationCores Cores;
+	// Steps the state has taken, less than the steps of the paths while it catches up with restored points.
+	// An extension counts from the end of the paths it was made from.
+	int NumStateSteps = 0;
+	FOrbitPaths Paths;
+	FOrbitPredictionSettings Settings;
+
+	void Step();
+};
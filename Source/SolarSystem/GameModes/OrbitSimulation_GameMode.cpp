@@ -33,9 +33,10 @@ AOrbitSimulation_GameMode::AOrbitSimulation_GameMode(): OrbitSimulation(nullptr)
 
 void AOrbitSimulation_GameMode::StartPlay()
 {
-	Super::StartPlay();
-	
+	// Before the actors begin play, so the celestial bodies find the registry when they register themselves
 	Initialize();
+	
+	Super::StartPlay();
 }
 
 void AOrbitSimulation_GameMode::Initialize()
@@ -6,22 +6,46 @@
 
 ACelestialBodyRegistry::ACelestialBodyRegistry()
 {
-	OnCelestialBodyAdded.AddDynamic(this, &ACelestialBodyRegistry::AddCelestialObject);
 }
 
-void ACelestialBodyRegistry::AddCelestialObject(ACelestialBody* CelestialObject)
+int32 ACelestialBodyRegistry::AddCelestialObject(ACelestialBody* CelestialObject)
 {
-	if (CelestialObject && !CelestialBodies.Contains(CelestialObject))
-	{
-		CelestialBodies.Add(CelestialObject);
-	}
+	if (!CelestialObject) return INDEX_NONE;
+	
+	// The body remembers its handle, so a second add is found without searching
+	if (GetCelestialObject(CelestialObject->RegistryHandle) == CelestialObject) return CelestialObject->RegistryHandle;
+
+	const int32 Handle = FreeHandles.Num() > 0 ? FreeHandles.Pop(false) : HandleIndices.Add(INDEX_NONE);
+	HandleIndices[Handle] = CelestialBodies.Add(CelestialObject);
+	BodyHandles.Add(Handle);
+	CelestialObject->RegistryHandle = Handle;
+
+	OnCelestialBodyAdded.Broadcast(CelestialObject);
+	return Handle;
 }
 
 void ACelestialBodyRegistry::RemoveCelestialObject(ACelestialBody* CelestialObject)
 {
-	if (CelestialBodies.Contains(CelestialObject))
+	if (!CelestialObject || GetCelestialObject(CelestialObject->RegistryHandle) != CelestialObject) return;
+
+	const int32 Handle = CelestialObject->RegistryHandle;
+	const int32 Index = HandleIndices[Handle];
+	CelestialBodies.RemoveAtSwap(Index, 1, false);
+	BodyHandles.RemoveAtSwap(Index, 1, false);
+	if (Index < CelestialBodies.Num())
 	{
-		CelestialBodies.Remove(CelestialObject);
+		HandleIndices[BodyHandles[Index]] = Index;
 	}
+
+	HandleIndices[Handle] = INDEX_NONE;
+	FreeHandles.Add(Handle);
+	CelestialObject->RegistryHandle = INDEX_NONE;
 }
 
+void ACelestialBodyRegistry::AddParticleField(AParticleBodyField* ParticleField)
+{
+	if (ParticleField)
+	{
+		ParticleFields.AddUnique(ParticleField);
+	}
+}
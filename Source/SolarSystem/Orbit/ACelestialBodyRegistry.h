@@ -5,12 +5,17 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "SolarSystem/CelestialBody/CelestialBody.h"
+#include "SolarSystem/CelestialBody/ParticleBodyField.h"
 #include "ACelestialBodyRegistry.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCelestialObjectAddedDelegate, ACelestialBody*, CelestialObject);
 
 /**
  * Manages all celestial bodies in the scene.
+ *
+ * The bodies are kept densely packed, so the simulation iterates them without gaps or copies. Every body gets a
+ * handle when it is added that stays valid until it is removed, even when other bodies are removed and the dense
+ * order changes. Adding and removing are O(1).
  */
 UCLASS()
 class SOLARSYSTEM_API ACelestialBodyRegistry : public AActor
@@ -20,6 +25,7 @@ class SOLARSYSTEM_API ACelestialBodyRegistry : public AActor
 public:
 	ACelestialBodyRegistry();
 
+	// Broadcast after a body was added, the registry itself does not listen to it.
 	UPROPERTY(BlueprintAssignable)
 	FCelestialObjectAddedDelegate OnCelestialBodyAdded;
 
@@ -27,11 +33,36 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Bodies")
 	TArray<ACelestialBody*> CelestialBodies;
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Celestial Bodies")
+	TArray<AParticleBodyField*> ParticleFields;
+
+private:
+	// The handle of every entry of CelestialBodies
+	TArray<int32> BodyHandles;
+	// The index into CelestialBodies of every handle, INDEX_NONE for a free handle
+	TArray<int32> HandleIndices;
+	TArray<int32> FreeHandles;
+
 public:
-	UFUNCTION()
-	void AddCelestialObject(ACelestialBody* CelestialObject);
-	
+	/**
+	 * Adds the body unless it is already registered.
+	 *
+	 * @return int32 The handle of the body.
+	 */
+	int32 AddCelestialObject(ACelestialBody* CelestialObject);
+
+	// Swaps the last body into the place of the removed one.
 	void RemoveCelestialObject(ACelestialBody* CelestialObject);
-	
-	TArray<ACelestialBody*> GetCelestialObjects() const { return CelestialBodies; }
+
+	ACelestialBody* GetCelestialObject(const int32 Handle) const
+	{
+		return HandleIndices.IsValidIndex(Handle) && HandleIndices[Handle] != INDEX_NONE ? CelestialBodies[HandleIndices[Handle]] : nullptr;
+	}
+
+	const TArray<ACelestialBody*>& GetCelestialObjects() const { return CelestialBodies; }
+
+	void AddParticleField(AParticleBodyField* ParticleField);
+	void RemoveParticleField(AParticleBodyField* ParticleField) { ParticleFields.RemoveSingleSwap(ParticleField); }
+
+	const TArray<AParticleBodyField*>& GetParticleFields() const { return ParticleFields; }
 };
@@ -0,0 +1,254 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "BarnesHutTree.h"
+
+#include "SolarSystem/Structs/Universe.h"
+#include <limits>
+
+
+template <typename ScalarType>
+void TBarnesHutTree<ScalarType>::Build(const TOrbitState<ScalarType>& State)
+{
+	Nodes.Reset();
+	SourceLeaves.SetNumUninitialized(State.NumSources);
+	if (State.NumSources == 0) return;
+
+	// The root cell is a cube around the bounding box of the sources, the tracers are never inserted
+	FVectorType Min(TNumericLimits<ScalarType>::Max());
+	FVectorType Max(-TNumericLimits<ScalarType>::Max());
+	for (int32 i = 0; i < State.NumSources; ++i)
+	{
+		const FVectorType Position(State.PositionX[i], State.PositionY[i], State.PositionZ[i]);
+		Min = FVectorType::Min(Min, Position);
+		Max = FVectorType::Max(Max, Position);
+	}
+
+	// Only a guess that fits well spread bodies. Close bodies subdivide over several levels and grow the array.
+	Nodes.Reserve(State.NumSources * 8 + 1);
+
+	FNode& Root = Nodes.AddDefaulted_GetRef();
+	Root.Center = (Min + Max) * 0.5f;
+	Root.HalfSize = FMath::Max<ScalarType>((Max - Min).GetMax() * 0.5f, KINDA_SMALL_NUMBER) * 1.001f;
+
+	// Cells smaller than the spacing of the representable positions can no longer separate two bodies
+	const ScalarType MaxCoordinate = FMath::Max(Min.GetAbs().GetMax(), Max.GetAbs().GetMax());
+	MinHalfSize = FMath::Max(MaxCoordinate, Root.HalfSize) * std::numeric_limits<ScalarType>::epsilon() * 4;
+
+	for (int32 i = 0; i < State.NumSources; ++i)
+	{
+		Insert(State, i);
+	}
+
+	FinishCentersOfMass();
+}
+
+template <typename ScalarType>
+void TBarnesHutTree<ScalarType>::Refit(const TOrbitState<ScalarType>& State)
+{
+	if (Nodes.Num() == 0 || SourceLeaves.Num() != State.NumSources)
+	{
+		Build(State);
+		return;
+	}
+
+	for (FNode& Node : Nodes)
+	{
+		Node.CenterOfMass = FVectorType::ZeroVector;
+		Node.Mass = 0;
+	}
+	for (int32 i = 0; i < State.NumSources; ++i)
+	{
+		FNode& Leaf = Nodes[SourceLeaves[i]];
+		Leaf.CenterOfMass += FVectorType(State.PositionX[i], State.PositionY[i], State.PositionZ[i]) * State.Mass[i];
+		Leaf.Mass += State.Mass[i];
+	}
+
+	// Children come after their parents, so a backward pass sums up every cell before its parent needs it
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex > 0; --NodeIndex)
+	{
+		FNode& Parent = Nodes[Nodes[NodeIndex].Parent];
+		Parent.CenterOfMass += Nodes[NodeIndex].CenterOfMass;
+		Parent.Mass += Nodes[NodeIndex].Mass;
+	}
+
+	FinishCentersOfMass();
+}
+
+template <typename ScalarType>
+void TBarnesHutTree<ScalarType>::FinishCentersOfMass()
+{
+	for (FNode& Node : Nodes)
+	{
+		Node.CenterOfMass = Node.Mass > 0.0f ? Node.CenterOfMass / Node.Mass : Node.Center;
+	}
+}
+
+template <typename ScalarType>
+void TBarnesHutTree<ScalarType>::Insert(const TOrbitState<ScalarType>& State, const int32 BodyIndex)
+{
+	const FVectorType Position(State.PositionX[BodyIndex], State.PositionY[BodyIndex], State.PositionZ[BodyIndex]);
+	const ScalarType Mass = State.Mass[BodyIndex];
+
+	int32 NodeIndex = 0;
+	for (int32 Depth = 0; ; ++Depth)
+	{
+		// Nodes may be reallocated by a subdivision, so they are always accessed by index
+		Nodes[NodeIndex].CenterOfMass += Position * Mass;
+		Nodes[NodeIndex].Mass += Mass;
+
+		if (!Nodes[NodeIndex].IsLeaf())
+		{
+			NodeIndex = Nodes[NodeIndex].FirstChild + GetOctant(Nodes[NodeIndex], Position);
+			continue;
+		}
+
+		if (Nodes[NodeIndex].Count == 0)
+		{
+			Nodes[NodeIndex].Body = BodyIndex;
+			Nodes[NodeIndex].Count = 1;
+			SourceLeaves[BodyIndex] = NodeIndex;
+			return;
+		}
+
+		if (Depth >= MaxDepth || Nodes[NodeIndex].HalfSize <= MinHalfSize)
+		{
+			// Coincident or nearly coincident bodies are merged into one leaf
+			Nodes[NodeIndex].Body = INDEX_NONE;
+			++Nodes[NodeIndex].Count;
+			SourceLeaves[BodyIndex] = NodeIndex;
+			return;
+		}
+
+		// Push the existing body one level down and continue with the new one
+		const int32 Existing = Nodes[NodeIndex].Body;
+		const FVectorType ExistingPosition(State.PositionX[Existing], State.PositionY[Existing], State.PositionZ[Existing]);
+		const ScalarType ExistingMass = State.Mass[Existing];
+
+		const int32 FirstChild = Subdivide(NodeIndex);
+		const int32 ExistingChildIndex = FirstChild + GetOctant(Nodes[NodeIndex], ExistingPosition);
+		SourceLeaves[Existing] = ExistingChildIndex;
+		FNode& ExistingChild = Nodes[ExistingChildIndex];
+		ExistingChild.Body = Existing;
+		ExistingChild.Count = 1;
+		ExistingChild.CenterOfMass = ExistingPosition * ExistingMass;
+		ExistingChild.Mass = ExistingMass;
+
+		NodeIndex = FirstChild + GetOctant(Nodes[NodeIndex], Position);
+	}
+}
+
+template <typename ScalarType>
+int32 TBarnesHutTree<ScalarType>::Subdivide(const int32 NodeIndex)
+{
+	const int32 FirstChild = Nodes.Num();
+	const FVectorType Center = Nodes[NodeIndex].Center;
+	const ScalarType ChildHalfSize = Nodes[NodeIndex].HalfSize * 0.5f;
+
+	for (int32 Octant = 0; Octant < 8; ++Octant)
+	{
+		FNode& Child = Nodes.AddDefaulted_GetRef();
+		Child.HalfSize = ChildHalfSize;
+		Child.Parent = NodeIndex;
+		Child.Center = Center + FVectorType(
+			(Octant & 1) ? ChildHalfSize : -ChildHalfSize,
+			(Octant & 2) ? ChildHalfSize : -ChildHalfSize,
+			(Octant & 4) ? ChildHalfSize : -ChildHalfSize);
+	}
+
+	Nodes[NodeIndex].FirstChild = FirstChild;
+	Nodes[NodeIndex].Body = INDEX_NONE;
+	return FirstChild;
+}
+
+template <typename ScalarType>
+int32 TBarnesHutTree<ScalarType>::GetOctant(const FNode& Node, const FVectorType& Position)
+{
+	return (Position.X >= Node.Center.X ? 1 : 0)
+		| (Position.Y >= Node.Center.Y ? 2 : 0)
+		| (Position.Z >= Node.Center.Z ? 4 : 0);
+}
+
+/**
+ * Calculates the gravitational acceleration of a body by walking the tree.
+ *
+ * A cell is accepted as a single point mass when its size divided by the distance to its center of mass
+ * is smaller than the opening angle (s / d < theta), otherwise its children are visited. The cells that contain
+ * the body itself are always visited, with an opening angle above about 0.58 they could be accepted and the body
+ * would pull on itself.
+ *
+ * @param State The state the tree was built from.
+ * @param BodyIndex The index of the object experiencing the gravitational force.
+ * @param OpeningAngle The opening angle theta, smaller values are more accurate.
+ * @param SqrSoftening The squared Plummer softening length, as used by the direct sum.
+ * @return FVector The calculated gravitational acceleration vector.
+ */
+template <typename ScalarType>
+FVector TBarnesHutTree<ScalarType>::CalculateAcceleration(const TOrbitState<ScalarType>& State, const int32 BodyIndex,
+	const ScalarType OpeningAngle, const ScalarType SqrSoftening) const
+{
+	if (Nodes.Num() == 0) return FVector::ZeroVector;
+
+	constexpr ScalarType G = static_cast<ScalarType>(FUniverse::GravitationalConstant);
+	const ScalarType SqrOpeningAngle = OpeningAngle * OpeningAngle;
+	const FVectorType Position(State.PositionX[BodyIndex], State.PositionY[BodyIndex], State.PositionZ[BodyIndex]);
+	const ScalarType BodyMass = State.Mass[BodyIndex];
+	// Tracers are in no leaf
+	const int32 BodyLeaf = BodyIndex < SourceLeaves.Num() ? SourceLeaves[BodyIndex] : INDEX_NONE;
+	// Found by the parents instead of the bounds, after a refit the body may have left its cells
+	TArray<int32, TInlineAllocator<MaxDepth + 1>> BodyCells;
+	for (int32 Cell = BodyLeaf; Cell != INDEX_NONE; Cell = Nodes[Cell].Parent)
+	{
+		BodyCells.Add(Cell);
+	}
+
+	FVectorType Acceleration = FVectorType::ZeroVector;
+
+	// Opening a cell replaces it with its eight children, so at most seven siblings wait on every level above the
+	// deepest opened cell. The stack never leaves its inline storage.
+	TArray<int32, TInlineAllocator<7 * MaxDepth + 1>> Stack;
+	Stack.Push(0);
+	while (Stack.Num() > 0)
+	{
+		const int32 NodeIndex = Stack.Pop(false);
+		const FNode& Node = Nodes[NodeIndex];
+		if (Node.Count == 0 || Node.Body == BodyIndex) continue;
+
+		FVectorType CenterOfMass = Node.CenterOfMass;
+		ScalarType Mass = Node.Mass;
+
+		if (Node.IsLeaf() && Node.Count > 1 && NodeIndex == BodyLeaf)
+		{
+			// The merged leaf contains the body itself, so its own contribution is taken out again
+			Mass -= BodyMass;
+			if (Mass <= 0.0f) continue;
+			CenterOfMass = (Node.CenterOfMass * Node.Mass - Position * BodyMass) / Mass;
+		}
+
+		const FVectorType R = CenterOfMass - Position;
+		const ScalarType SqrR = R.SizeSquared();
+		const ScalarType SqrSize = 4.0f * Node.HalfSize * Node.HalfSize;
+
+		if (Node.IsLeaf() || (SqrSize < SqrOpeningAngle * SqrR && !BodyCells.Contains(NodeIndex)))
+		{
+			// The same cutoff as the direct sum, so both solvers agree for close bodies
+			const ScalarType SoftenedSqrR = SqrR + SqrSoftening;
+			if (SoftenedSqrR <= 0.0f) continue;
+
+			const ScalarType InvR = FMath::InvSqrt(SoftenedSqrR);
+			Acceleration += R * (G * Mass * InvR * InvR * InvR);
+		}
+		else
+		{
+			for (int32 Octant = 0; Octant < 8; ++Octant)
+			{
+				Stack.Push(Node.FirstChild + Octant);
+			}
+		}
+	}
+
+	return FVector(Acceleration);
+}
+
+template class TBarnesHutTree<float>;
+template class TBarnesHutTree<double>;
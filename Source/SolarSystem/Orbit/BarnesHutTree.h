@@ -0,0 +1,69 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SolarSystem/Structs/OrbitState.h"
+
+/**
+ * Barnes-Hut octree over the bodies of an orbit state.
+ * Distant groups of bodies are approximated by their center of mass, which brings the force calculation
+ * down from O(N^2) to O(N log N). The opening angle controls the accuracy: 0 equals the direct sum.
+ * The tree is instantiated for float and double states.
+ */
+template <typename ScalarType>
+class TBarnesHutTree
+{
+public:
+	void Build(const TOrbitState<ScalarType>& State);
+
+	/**
+	 * Recomputes the masses and centers of mass of the cells from the current positions, but keeps the cells and
+	 * the cell of every body. Much cheaper than a build and without allocations, but a body that moved out of its
+	 * cell makes the cell effectively larger than the opening angle assumes. Builds the tree if the sources changed.
+	 */
+	void Refit(const TOrbitState<ScalarType>& State);
+
+	FVector CalculateAcceleration(const TOrbitState<ScalarType>& State, const int32 BodyIndex, const ScalarType OpeningAngle,
+		const ScalarType SqrSoftening = 0) const;
+
+	int32 GetNumNodes() const { return Nodes.Num(); }
+	SIZE_T GetAllocatedSize() const { return Nodes.GetAllocatedSize() + SourceLeaves.GetAllocatedSize(); }
+
+private:
+	using FVectorType = UE::Math::TVector<ScalarType>;
+
+	// Bodies that end up in the same cell at this depth, or in a cell of at most MinHalfSize, are merged into one leaf
+	static constexpr int32 MaxDepth = 32;
+	ScalarType MinHalfSize = 0;
+
+	struct FNode
+	{
+		FVectorType Center = FVectorType::ZeroVector;
+		ScalarType HalfSize = 0;
+
+		// Accumulated mass * position during the build, center of mass afterward
+		FVectorType CenterOfMass = FVectorType::ZeroVector;
+		ScalarType Mass = 0;
+
+		// Index of the first of eight contiguous children, INDEX_NONE for leaves. Children always come after their parent.
+		int32 FirstChild = INDEX_NONE;
+		int32 Parent = INDEX_NONE;
+		// Index of the body of a leaf holding exactly one body
+		int32 Body = INDEX_NONE;
+		int32 Count = 0;
+
+		bool IsLeaf() const { return FirstChild == INDEX_NONE; }
+	};
+
+	TArray<FNode> Nodes;
+	// The leaf of every source
+	TArray<int32> SourceLeaves;
+
+	void Insert(const TOrbitState<ScalarType>& State, const int32 BodyIndex);
+	int32 Subdivide(const int32 NodeIndex);
+	static int32 GetOctant(const FNode& Node, const FVectorType& Position);
+	void FinishCentersOfMass();
+};
+
+using FBarnesHutTree = TBarnesHutTree<float>;
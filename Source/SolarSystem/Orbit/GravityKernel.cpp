@@ -0,0 +1,131 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "GravityKernel.h"
+
+#include "Math/VectorRegister.h"
+#include "SolarSystem/Structs/Universe.h"
+
+namespace
+{
+	struct FAccelerationSum
+	{
+		VectorRegister4Float X = VectorZeroFloat();
+		VectorRegister4Float Y = VectorZeroFloat();
+		VectorRegister4Float Z = VectorZeroFloat();
+
+		// Remainder that does not fill a whole register
+		float TailX = 0.0f;
+		float TailY = 0.0f;
+		float TailZ = 0.0f;
+	};
+
+	void AccumulateRange(const FGravitySources& Sources, const int32 Begin, const int32 End, const FVector3f& Position,
+		const float SqrSoftening, FAccelerationSum& Sum)
+	{
+		constexpr float G = static_cast<float>(FUniverse::GravitationalConstant);
+
+		const VectorRegister4Float PX = VectorSetFloat1(Position.X);
+		const VectorRegister4Float PY = VectorSetFloat1(Position.Y);
+		const VectorRegister4Float PZ = VectorSetFloat1(Position.Z);
+		const VectorRegister4Float Softening = VectorSetFloat1(SqrSoftening);
+		const VectorRegister4Float GravitationalConstant = VectorSetFloat1(G);
+		const VectorRegister4Float Zero = VectorZeroFloat();
+
+		int32 i = Begin;
+		for (; i + 4 <= End; i += 4)
+		{
+			// Distance between the objects r = |r1 - r2|
+			const VectorRegister4Float RX = VectorSubtract(VectorLoad(Sources.X + i), PX);
+			const VectorRegister4Float RY = VectorSubtract(VectorLoad(Sources.Y + i), PY);
+			const VectorRegister4Float RZ = VectorSubtract(VectorLoad(Sources.Z + i), PZ);
+
+			// r^2 + eps^2
+			VectorRegister4Float SqrR = VectorMultiplyAdd(RX, RX, Softening);
+			SqrR = VectorMultiplyAdd(RY, RY, SqrR);
+			SqrR = VectorMultiplyAdd(RZ, RZ, SqrR);
+
+			// G * M / r^3, masked to zero for coincident bodies
+			const VectorRegister4Float InvR = VectorReciprocalSqrt(SqrR);
+			const VectorRegister4Float InvR3 = VectorMultiply(InvR, VectorMultiply(InvR, InvR));
+			const VectorRegister4Float Factor = VectorSelect(VectorCompareGT(SqrR, Zero),
+				VectorMultiply(VectorMultiply(GravitationalConstant, VectorLoad(Sources.Mass + i)), InvR3), Zero);
+
+			Sum.X = VectorMultiplyAdd(RX, Factor, Sum.X);
+			Sum.Y = VectorMultiplyAdd(RY, Factor, Sum.Y);
+			Sum.Z = VectorMultiplyAdd(RZ, Factor, Sum.Z);
+		}
+
+		for (; i < End; ++i)
+		{
+			const float RX = Sources.X[i] - Position.X;
+			const float RY = Sources.Y[i] - Position.Y;
+			const float RZ = Sources.Z[i] - Position.Z;
+			const float SqrR = RX * RX + RY * RY + RZ * RZ + SqrSoftening;
+			if (SqrR <= 0.0f) continue;
+
+			const float InvR = FMath::InvSqrt(SqrR);
+			const float Factor = G * Sources.Mass[i] * InvR * InvR * InvR;
+			Sum.TailX += RX * Factor;
+			Sum.TailY += RY * Factor;
+			Sum.TailZ += RZ * Factor;
+		}
+	}
+
+	float HorizontalSum(const VectorRegister4Float& Vector)
+	{
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(Vector, Lanes);
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+}
+
+FVector GravityKernel::CalculateAcceleration(const FGravitySources& Sources, const FVector& Position,
+	const int32 ExcludeIndex, const float SqrSoftening)
+{
+	const FVector3f Target(Position);
+	FAccelerationSum Sum;
+
+	if (Sources.Num > ExcludeIndex && ExcludeIndex >= 0)
+	{
+		AccumulateRange(Sources, 0, ExcludeIndex, Target, SqrSoftening, Sum);
+		AccumulateRange(Sources, ExcludeIndex + 1, Sources.Num, Target, SqrSoftening, Sum);
+	}
+	else
+	{
+		AccumulateRange(Sources, 0, Sources.Num, Target, SqrSoftening, Sum);
+	}
+
+	return FVector(
+		HorizontalSum(Sum.X) + Sum.TailX,
+		HorizontalSum(Sum.Y) + Sum.TailY,
+		HorizontalSum(Sum.Z) + Sum.TailZ);
+}
+
+FVector GravityKernel::CalculateAcceleration(const TGravitySources<double>& Sources, const FVector& Position,
+	const int32 ExcludeIndex, const double SqrSoftening)
+{
+	constexpr double G = FUniverse::GravitationalConstant;
+
+	double AccelerationX = 0.0;
+	double AccelerationY = 0.0;
+	double AccelerationZ = 0.0;
+	for (int32 i = 0; i < Sources.Num; ++i)
+	{
+		if (i == ExcludeIndex) continue;
+
+		const double RX = Sources.X[i] - Position.X;
+		const double RY = Sources.Y[i] - Position.Y;
+		const double RZ = Sources.Z[i] - Position.Z;
+		const double SqrR = RX * RX + RY * RY + RZ * RZ + SqrSoftening;
+		if (SqrR <= 0.0) continue;
+
+		const double InvR = 1.0 / FMath::Sqrt(SqrR);
+		const double Factor = G * Sources.Mass[i] * InvR * InvR * InvR;
+		AccelerationX += RX * Factor;
+		AccelerationY += RY * Factor;
+		AccelerationZ += RZ * Factor;
+	}
+
+	return FVector(AccelerationX, AccelerationY, AccelerationZ);
+}
@@ -0,0 +1,58 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SolarSystem/Structs/OrbitState.h"
+
+/**
+ * View on the structure-of-arrays positions and masses of the bodies that exert gravity.
+ */
+template <typename ScalarType>
+struct TGravitySources
+{
+	const ScalarType* X = nullptr;
+	const ScalarType* Y = nullptr;
+	const ScalarType* Z = nullptr;
+	const ScalarType* Mass = nullptr;
+	int32 Num = 0;
+
+	TGravitySources() = default;
+
+	explicit TGravitySources(const TOrbitState<ScalarType>& State)
+		: X(State.PositionX.GetData()), Y(State.PositionY.GetData()), Z(State.PositionZ.GetData()),
+		  Mass(State.Mass.GetData()), Num(State.NumSources)
+	{
+	}
+};
+
+using FGravitySources = TGravitySources<float>;
+
+/**
+ * Vectorized pairwise gravity kernel shared by the runtime simulation and the editor orbit preview.
+ */
+namespace GravityKernel
+{
+	/**
+	 * Sums up the gravitational acceleration of all sources at a position, four interactions at a time.
+	 *
+	 * Each pair costs a single reciprocal square root for the 1 / r^3 term. The optional Plummer softening
+	 * a = G * M * r / (r^2 + eps^2)^(3/2) removes the singularity when bodies get close.
+	 * Without softening, sources that coincide with the position are ignored.
+	 *
+	 * @param Sources The bodies exerting the gravitational force.
+	 * @param Position The position of the object experiencing the gravitational force.
+	 * @param ExcludeIndex The source index of the object itself, or INDEX_NONE.
+	 * @param SqrSoftening The squared Plummer softening length eps^2.
+	 * @return FVector The calculated gravitational acceleration vector.
+	 */
+	SOLARSYSTEM_API FVector CalculateAcceleration(const TGravitySources<float>& Sources, const FVector& Position,
+		const int32 ExcludeIndex, const float SqrSoftening);
+
+	/**
+	 * Double precision variant of the kernel. It sums up one interaction at a time with an exact square root,
+	 * so the small distances within a real-scale system are not lost next to the large ones.
+	 */
+	SOLARSYSTEM_API FVector CalculateAcceleration(const TGravitySources<double>& Sources, const FVector& Position,
+		const int32 ExcludeIndex, const double SqrSoftening);
+}
@@ -0,0 +1,311 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "OrbitIntegration.h"
+
+namespace
+{
+	// Moves the positions along the velocities, x += Coefficient * v
+	template <typename ScalarType>
+	void Drift(TOrbitState<ScalarType>& State, const ScalarType Coefficient)
+	{
+		ScalarType* X = State.PositionX.GetData();
+		ScalarType* Y = State.PositionY.GetData();
+		ScalarType* Z = State.PositionZ.GetData();
+		const ScalarType* VX = State.VelocityX.GetData();
+		const ScalarType* VY = State.VelocityY.GetData();
+		const ScalarType* VZ = State.VelocityZ.GetData();
+
+		for (int32 i = 0; i < State.Num(); ++i)
+		{
+			X[i] += Coefficient * VX[i];
+			Y[i] += Coefficient * VY[i];
+			Z[i] += Coefficient * VZ[i];
+		}
+	}
+
+	// Changes the velocities by the accelerations, v += Coefficient * a
+	template <typename ScalarType>
+	void Kick(TOrbitState<ScalarType>& State, const ScalarType Coefficient)
+	{
+		ScalarType* VX = State.VelocityX.GetData();
+		ScalarType* VY = State.VelocityY.GetData();
+		ScalarType* VZ = State.VelocityZ.GetData();
+		const ScalarType* AX = State.AccelerationX.GetData();
+		const ScalarType* AY = State.AccelerationY.GetData();
+		const ScalarType* AZ = State.AccelerationZ.GetData();
+
+		for (int32 i = 0; i < State.Num(); ++i)
+		{
+			VX[i] += Coefficient * AX[i];
+			VY[i] += Coefficient * AY[i];
+			VZ[i] += Coefficient * AZ[i];
+		}
+	}
+
+	template <typename ScalarType>
+	void StepSemiImplicitEuler(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations)
+	{
+		CalculateAccelerations(State, nullptr);
+		Kick(State, h);
+		Drift(State, h);
+	}
+
+	template <typename ScalarType>
+	void StepLeapfrog(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations)
+	{
+		Drift(State, 0.5f * h);
+		CalculateAccelerations(State, nullptr);
+		Kick(State, h);
+		Drift(State, 0.5f * h);
+	}
+
+	template <typename ScalarType>
+	void StepVelocityVerlet(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations,
+		TOrbitIntegratorContext<ScalarType>& Context)
+	{
+		if (!Context.bAccelerationsValid)
+		{
+			CalculateAccelerations(State, nullptr);
+		}
+		Kick(State, 0.5f * h);
+		Drift(State, h);
+		CalculateAccelerations(State, nullptr);
+		Kick(State, 0.5f * h);
+
+		// The accelerations belong to the new positions and start the next step
+		Context.bAccelerationsValid = true;
+	}
+
+	/**
+	 * Fourth order symplectic integrator by Yoshida (1990), a composition of three leapfrog steps
+	 * with the weights w1, w0, w1. https://doi.org/10.1016/0375-9601(90)90092-3
+	 */
+	template <typename ScalarType>
+	void StepYoshida4(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations)
+	{
+		const double CubeRootOfTwo = FMath::Pow(2.0, 1.0 / 3.0);
+		const ScalarType W1 = 1.0 / (2.0 - CubeRootOfTwo);
+		const ScalarType W0 = -CubeRootOfTwo * W1;
+
+		Drift(State, 0.5f * W1 * h);
+		CalculateAccelerations(State, nullptr);
+		Kick(State, W1 * h);
+		Drift(State, 0.5f * (W0 + W1) * h);
+		CalculateAccelerations(State, nullptr);
+		Kick(State, W0 * h);
+		Drift(State, 0.5f * (W0 + W1) * h);
+		CalculateAccelerations(State, nullptr);
+		Kick(State, W1 * h);
+		Drift(State, 0.5f * W1 * h);
+	}
+
+	/**
+	 * Hierarchical kick-drift-kick leapfrog with power-of-two block timesteps.
+	 *
+	 * At the start of the step every body gets the coarsest level L whose substep TimeStep / 2^L satisfies the
+	 * acceleration criterion. All bodies drift with the finest substep, but only the bodies that end one of
+	 * their own substeps get new accelerations and a kick. Tightly bound bodies substep while the outer
+	 * ones step coarsely, so most force evaluations are saved for the bodies that need them.
+	 */
+	template <typename ScalarType>
+	void StepAdaptiveBlockLeapfrog(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations,
+		TOrbitIntegratorContext<ScalarType>& Context)
+	{
+		// A context that was never configured would silently run with made up levels
+		checkf(Context.MaxTimestepLevel >= 0 && Context.TimestepAccuracy > 0.0f,
+			TEXT("The adaptive block leapfrog needs MaxTimestepLevel and TimestepAccuracy from the simulation settings"));
+
+		const int32 Num = State.Num();
+		if (!Context.bAccelerationsValid)
+		{
+			CalculateAccelerations(State, nullptr);
+		}
+
+		TArray<int32>& Levels = Context.TimestepLevels;
+		Levels.SetNumUninitialized(Num);
+		const int32 MaxLevel = FMath::Clamp(Context.MaxTimestepLevel, 0, 16);
+		int32 DeepestLevel = 0;
+		for (int32 i = 0; i < Num; ++i)
+		{
+			const ScalarType Acceleration = State.GetAcceleration(i).Size();
+			int32 Level = 0;
+			if (Acceleration > SMALL_NUMBER)
+			{
+				const ScalarType DesiredStep = FMath::Sqrt(2.0f * Context.TimestepAccuracy / Acceleration);
+				Level = FMath::Clamp(FMath::CeilToInt32(FMath::Log2(h / DesiredStep)), 0, MaxLevel);
+			}
+			Levels[i] = Level;
+			DeepestLevel = FMath::Max(DeepestLevel, Level);
+		}
+
+		const int32 NumSubsteps = 1 << DeepestLevel;
+		const ScalarType Substep = h / NumSubsteps;
+		TArray<int32>& Active = Context.ActiveBodies;
+
+		for (int32 SubstepIndex = 0; SubstepIndex < NumSubsteps; ++SubstepIndex)
+		{
+			// Opening half kick of the bodies that start one of their substeps
+			for (int32 i = 0; i < Num; ++i)
+			{
+				const int32 Stride = 1 << (DeepestLevel - Levels[i]);
+				if (SubstepIndex % Stride == 0)
+				{
+					State.SetVelocity(i, State.GetVelocity(i) + 0.5f * Stride * Substep * State.GetAcceleration(i));
+				}
+			}
+
+			Drift(State, Substep);
+
+			// Closing half kick of the bodies that end one of their substeps
+			Active.Reset();
+			for (int32 i = 0; i < Num; ++i)
+			{
+				if ((SubstepIndex + 1) % (1 << (DeepestLevel - Levels[i])) == 0)
+				{
+					Active.Add(i);
+				}
+			}
+
+			CalculateAccelerations(State, &Active);
+			for (const int32 i : Active)
+			{
+				const int32 Stride = 1 << (DeepestLevel - Levels[i]);
+				State.SetVelocity(i, State.GetVelocity(i) + 0.5f * Stride * Substep * State.GetAcceleration(i));
+			}
+		}
+
+		// After the last substep every body is synchronized and has the accelerations of its final position
+		Context.bAccelerationsValid = true;
+	}
+
+	/**
+	 * Classic fourth order Runge-Kutta step for the whole system.
+	 *
+	 * Every stage advances all bodies together, so the accelerations of a stage are evaluated with the stage
+	 * positions of all other bodies as well. Each stage is a single force evaluation of the whole state.
+	 */
+	template <typename ScalarType>
+	void StepRungeKutta4(TOrbitState<ScalarType>& State, const ScalarType h,
+		OrbitIntegration::TCalculateAccelerations<ScalarType> CalculateAccelerations,
+		TOrbitIntegratorContext<ScalarType>& Context)
+	{
+		const int32 Num = State.Num();
+		TOrbitState<ScalarType>& Initial = Context.Initial;
+		TOrbitState<ScalarType>& Delta = Context.Delta;
+		if (Initial.Num() != Num)
+		{
+			Initial.SetNum(Num);
+			Delta.SetNum(Num);
+		}
+
+		struct FComponent
+		{
+			ScalarType* X;
+			ScalarType* V;
+			const ScalarType* A;
+			ScalarType* X0;
+			ScalarType* V0;
+			ScalarType* DX;
+			ScalarType* DV;
+		};
+
+		const FComponent Components[3] = {
+			{ State.PositionX.GetData(), State.VelocityX.GetData(), State.AccelerationX.GetData(), Initial.PositionX.GetData(),
+				Initial.VelocityX.GetData(), Delta.PositionX.GetData(), Delta.VelocityX.GetData() },
+			{ State.PositionY.GetData(), State.VelocityY.GetData(), State.AccelerationY.GetData(), Initial.PositionY.GetData(),
+				Initial.VelocityY.GetData(), Delta.PositionY.GetData(), Delta.VelocityY.GetData() },
+			{ State.PositionZ.GetData(), State.VelocityZ.GetData(), State.AccelerationZ.GetData(), Initial.PositionZ.GetData(),
+				Initial.VelocityZ.GetData(), Delta.PositionZ.GetData(), Delta.VelocityZ.GetData() }
+		};
+
+		for (const FComponent& C : Components)
+		{
+			FMemory::Memcpy(C.X0, C.X, Num * sizeof(ScalarType));
+			FMemory::Memcpy(C.V0, C.V, Num * sizeof(ScalarType));
+		}
+
+		// Stage 1: derivatives at the start of the step
+		CalculateAccelerations(State, nullptr);
+		for (const FComponent& C : Components)
+		{
+			for (int32 i = 0; i < Num; ++i)
+			{
+				C.DX[i] = C.V[i];
+				C.DV[i] = C.A[i];
+				C.X[i] = C.X0[i] + 0.5f * h * C.V[i];
+				C.V[i] = C.V0[i] + 0.5f * h * C.A[i];
+			}
+		}
+
+		// Stage 2 and 3: derivatives at the midpoint, each based on the previous stage
+		for (int32 Stage = 2; Stage <= 3; ++Stage)
+		{
+			const ScalarType StageStep = Stage == 2 ? 0.5f * h : h;
+			CalculateAccelerations(State, nullptr);
+			for (const FComponent& C : Components)
+			{
+				for (int32 i = 0; i < Num; ++i)
+				{
+					C.DX[i] += 2.0f * C.V[i];
+					C.DV[i] += 2.0f * C.A[i];
+					C.X[i] = C.X0[i] + StageStep * C.V[i];
+					C.V[i] = C.V0[i] + StageStep * C.A[i];
+				}
+			}
+		}
+
+		// Stage 4: derivatives at the end of the step
+		CalculateAccelerations(State, nullptr);
+		for (const FComponent& C : Components)
+		{
+			for (int32 i = 0; i < Num; ++i)
+			{
+				C.DX[i] += C.V[i];
+				C.DV[i] += C.A[i];
+				C.X[i] = C.X0[i] + h / 6.0f * C.DX[i];
+				C.V[i] = C.V0[i] + h / 6.0f * C.DV[i];
+			}
+		}
+	}
+}
+
+template <typename ScalarType>
+void OrbitIntegration::Step(const OrbitCore::EIntegrator Integrator, TOrbitState<ScalarType>& State, const ScalarType TimeStep,
+	TCalculateAccelerations<ScalarType> CalculateAccelerations, TOrbitIntegratorContext<ScalarType>& Context)
+{
+	switch (Integrator)
+	{
+	case OrbitCore::EIntegrator::SemiImplicitEuler:
+		StepSemiImplicitEuler(State, TimeStep, CalculateAccelerations);
+		break;
+	case OrbitCore::EIntegrator::Leapfrog:
+		StepLeapfrog(State, TimeStep, CalculateAccelerations);
+		break;
+	case OrbitCore::EIntegrator::VelocityVerlet:
+		StepVelocityVerlet(State, TimeStep, CalculateAccelerations, Context);
+		return;
+	case OrbitCore::EIntegrator::Yoshida4:
+		StepYoshida4(State, TimeStep, CalculateAccelerations);
+		break;
+	case OrbitCore::EIntegrator::RungeKutta4:
+		StepRungeKutta4(State, TimeStep, CalculateAccelerations, Context);
+		break;
+	case OrbitCore::EIntegrator::AdaptiveBlockLeapfrog:
+		StepAdaptiveBlockLeapfrog(State, TimeStep, CalculateAccelerations, Context);
+		return;
+	}
+
+	// Every other integrator leaves accelerations behind that do not belong to the final positions
+	Context.Invalidate();
+}
+
+template void OrbitIntegration::Step<float>(const OrbitCore::EIntegrator, TOrbitState<float>&, const float,
+	TCalculateAccelerations<float>, TOrbitIntegratorContext<float>&);
+template void OrbitIntegration::Step<double>(const OrbitCore::EIntegrator, TOrbitState<double>&, const double,
+	TCalculateAccelerations<double>, TOrbitIntegratorContext<double>&);
@@ -0,0 +1,61 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SolarSystem/Structs/OrbitCoreTypes.h"
+#include "SolarSystem/Structs/OrbitState.h"
+
+/**
+ * Scratch data an integrator keeps between calls. It is sized on the first step, so later steps do not allocate.
+ */
+template <typename ScalarType>
+struct TOrbitIntegratorContext
+{
+	// State at the start of a Runge-Kutta step
+	TOrbitState<ScalarType> Initial;
+	// Weighted sums of the Runge-Kutta stages, the positions hold the velocities, the velocities the accelerations
+	TOrbitState<ScalarType> Delta;
+	// Velocity Verlet reuses the accelerations of the last step when the positions did not change in between
+	bool bAccelerationsValid = false;
+
+	// Deepest level of the adaptive block timesteps, a body on level L takes substeps of TimeStep / 2^L.
+	// Has no default, every owner must copy it from its settings before the first adaptive step.
+	int32 MaxTimestepLevel = INDEX_NONE;
+	// Distance a body may fall freely within one of its substeps, dt = sqrt(2 * TimestepAccuracy / |a|)
+	float TimestepAccuracy = 0.0f;
+	TArray<int32> TimestepLevels;
+	TArray<int32> ActiveBodies;
+
+	void Invalidate() { bAccelerationsValid = false; }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Initial.GetAllocatedSize() + Delta.GetAllocatedSize() + TimestepLevels.GetAllocatedSize() + ActiveBodies.GetAllocatedSize();
+	}
+};
+
+using FOrbitIntegratorContext = TOrbitIntegratorContext<float>;
+
+/**
+ * Integrators shared by the runtime simulation and the editor orbit prediction.
+ */
+namespace OrbitIntegration
+{
+	// Fills the accelerations of the target bodies from the current positions of all bodies, nullptr targets all
+	template <typename ScalarType>
+	using TCalculateAccelerations = TFunctionRef<void(TOrbitState<ScalarType>& State, const TArray<int32>* Targets)>;
+
+	/**
+	 * Advances the positions and velocities of all bodies by one time step. Instantiated for float and double states.
+	 *
+	 * @param Integrator The integration method.
+	 * @param State The state to advance in place.
+	 * @param TimeStep The time step.
+	 * @param CalculateAccelerations Evaluates the gravitational accelerations of the state.
+	 * @param Context Scratch data of the integrator, kept between the steps.
+	 */
+	template <typename ScalarType>
+	void Step(const OrbitCore::EIntegrator Integrator, TOrbitState<ScalarType>& State, const ScalarType TimeStep,
+		TCalculateAccelerations<ScalarType> CalculateAccelerations, TOrbitIntegratorContext<ScalarType>& Context);
+}
@@ -6,10 +6,15 @@
 #include "SolarSystem/GameModes/OrbitSimulation_GameMode.h"
 #include "SolarSystem/Structs/Universe.h"
 #include "ACelestialBodyRegistry.h"
+#include "Algo/MaxElement.h"
 #include "../Defines/Debug.h"
 
 
-AOrbitSimulation::AOrbitSimulation(): bManualTimeScale(false), TimeScale(10.0f), CelestialBodyRegistry(nullptr)
+AOrbitSimulation::AOrbitSimulation(): bManualTimeScale(false), TimeScale(10.0f), bFixedTimestep(false), bSimulationThread(false), FixedStepRate(60.0f),
+	MaxSubstepsPerFrame(8), bCatchUpDroppedTime(false), Integrator(EOrbitIntegrator::VelocityVerlet),
+	bLegacyPhysicsMovement(false), bKinematicBodies(false), bDoublePrecision(false), bFloatingOrigin(false), GravitySolver(EGravitySolver::DirectSum),
+	OpeningAngle(0.5f), SofteningLength(0.0f), MaxTimestepLevel(6), TimestepAccuracy(10.0f), bParallelForces(true), ParallelBatchSize(32),
+	bReportSolverError(false), SolverErrorReportInterval(120), CelestialBodyRegistry(nullptr)
 {
 	PrimaryActorTick.bCanEverTick = true;
 }
@@ -19,23 +24,190 @@ void AOrbitSimulation::BeginPlay()
 	Super::BeginPlay();
 
 	GetCelestialBodyRegistry();
+	
+	if (IsPhysicsDriven() && (bFixedTimestep || bSimulationThread))
+	{
+		LOG_WARNING("The legacy physics movement steps once per frame, the fixed timestep and the simulation thread are ignored.")
+	}
+}
+
+void AOrbitSimulation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopSimulationThread();
+	
+	Super::EndPlay(EndPlayReason);
 }
 
 void AOrbitSimulation::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	if (bSimulationThread && !IsPhysicsDriven())
+	{
+		TickSimulationThread();
+		return;
+	}
+	StopSimulationThread();
+
+	// The physics engine moves its bodies once per frame, so it cannot take fixed substeps
+	if (bFixedTimestep && !IsPhysicsDriven())
+	{
+		TickFixedTimestep(DeltaTime);
+		return;
+	}
 	
 	DeltaTime = FUniverse::TimeStep;
 	const float ScaledDeltaTime = bManualTimeScale ? DeltaTime * TimeScale : DeltaTime;
 	UpdateAllObjects(ScaledDeltaTime);
 }
 
-void AOrbitSimulation::UpdateAllObjects(const float& TimeStep) const
+/**
+ * Accumulates the real frame time and takes as many fixed steps as fit into it. The remainder is carried over
+ * to the next frame and used to interpolate the rendered locations between the last two steps.
+ */
+void AOrbitSimulation::TickFixedTimestep(const float DeltaTime)
+{
+	const float StepInterval = 1.0f / FMath::Max(FixedStepRate, 1.0f);
+	const int32 MaxSubsteps = FMath::Max(MaxSubstepsPerFrame, 1);
+
+	TimeAccumulator += DeltaTime;
+	int32 NumSubsteps = FMath::FloorToInt32(TimeAccumulator / StepInterval);
+	if (NumSubsteps > MaxSubsteps)
+	{
+		NumSubsteps = MaxSubsteps;
+		TimeAccumulator = bCatchUpDroppedTime
+			? FMath::Min(TimeAccumulator, 2 * MaxSubsteps * StepInterval)
+			: MaxSubsteps * StepInterval + FMath::Fmod(TimeAccumulator, StepInterval);
+	}
+	TimeAccumulator -= NumSubsteps * StepInterval;
+
+	const float ScaledTimeStep = bManualTimeScale ? FUniverse::TimeStep * TimeScale : FUniverse::TimeStep;
+	UpdateAllObjects(ScaledTimeStep, NumSubsteps, FMath::Clamp(TimeAccumulator / StepInterval, 0.0f, 1.0f));
+}
+
+/**
+ * Starts the simulation thread, or restarts it when the bodies or the settings changed, and writes the latest
+ * published step to the bodies. The game thread never waits for the solver.
+ */
+void AOrbitSimulation::TickSimulationThread()
+{
+	if (!CelestialBodyRegistry)
+	{
+		LOG_DISPLAY("CelestialObjectManager is nullptr!");
+		return;
+	}
+
+	const TArray<ACelestialBody*>& Bodies = CelestialBodyRegistry->GetCelestialObjects();
+	const TArray<AParticleBodyField*>& Fields = CelestialBodyRegistry->GetParticleFields();
+	const FOrbitSimulationThreadSettings Settings = GetSimulationThreadSettings();
+	if (!SimulationThread || StateBodies != Bodies || StateFields != Fields || SimulationThread->GetSettings() != Settings)
+	{
+		StopSimulationThread();
+		GatherState(Bodies, Fields);
+		SimulationThread = MakeUnique<FOrbitSimulationThread>(Cores, Settings);
+	}
+
+	const FOrbitSnapshot* Snapshot = SimulationThread->ReadSnapshot();
+	if (!Snapshot) return;
+	
+	for (int32 i = 0; i < Bodies.Num(); ++i)
+	{
+		// The state is only gathered when the thread starts, so a change of the mode is applied here
+		Bodies[i]->SetKinematic(bKinematicBodies);
+		Bodies[i]->SetCurrentVelocity(Snapshot->Velocities[BodyStateIndices[i]]);
+		Bodies[i]->SetSimulatedLocation(Snapshot->Positions[BodyStateIndices[i]]);
+	}
+	ScatterFields([Snapshot](const int32 StateIndex) { return Snapshot->Positions[StateIndex]; });
+}
+
+/**
+ * Stops the simulation thread and continues with its last state, so the simulation can switch back to the game thread.
+ */
+void AOrbitSimulation::StopSimulationThread()
+{
+	if (!SimulationThread) return;
+
+	SimulationThread->Shutdown();
+	if (SimulationThread->GetSettings().Simulation.bDoublePrecision)
+	{
+		Cores.Double = SimulationThread->GetCores().Double;
+	}
+	else
+	{
+		Cores.Float = SimulationThread->GetCores().Float;
+	}
+	Cores.Visit(bStateDoublePrecision, [this](auto& Core)
+	{
+		for (int32 i = 0; i < Core.State.Num(); ++i)
+		{
+			PreviousPositions[i] = Core.GetWorldPosition(i);
+		}
+		Core.Invalidate();
+	});
+	SimulationThread.Reset();
+}
+
+FOrbitSimulationSettings AOrbitSimulation::GetSimulationSettings() const
+{
+	FOrbitSimulationSettings Settings;
+	Settings.Integrator = ToCore(Integrator);
+	Settings.GravitySolver = ToCore(GravitySolver);
+	Settings.OpeningAngle = OpeningAngle;
+	Settings.SofteningLength = SofteningLength;
+	Settings.MaxTimestepLevel = MaxTimestepLevel;
+	Settings.TimestepAccuracy = TimestepAccuracy;
+	Settings.ParallelBatchSize = bParallelForces ? FMath::Max(1, ParallelBatchSize) : 0;
+	Settings.bDoublePrecision = bDoublePrecision;
+	Settings.bFloatingOrigin = bFloatingOrigin;
+	return Settings;
+}
+
+FOrbitSimulationThreadSettings AOrbitSimulation::GetSimulationThreadSettings() const
+{
+	FOrbitSimulationThreadSettings Settings;
+	Settings.Simulation = GetSimulationSettings();
+	Settings.TimeStep = bManualTimeScale ? FUniverse::TimeStep * TimeScale : FUniverse::TimeStep;
+	Settings.StepRate = FixedStepRate;
+	return Settings;
+}
+
+void AOrbitSimulation::UpdateAllObjects(const float& TimeStep, const int32 NumSubsteps, const float InterpolationAlpha)
 {
 	if (CelestialBodyRegistry)
 	{
-		UpdateAllPositions(TimeStep);
-		UpdateAllVelocities(TimeStep);
+		const TArray<ACelestialBody*>& Bodies = CelestialBodyRegistry->GetCelestialObjects();
+		GatherState(Bodies, CelestialBodyRegistry->GetParticleFields());
+		
+		if (IsPhysicsDriven())
+		{
+			UpdateAllPositions(Bodies, TimeStep);
+			UpdateAllVelocities(TimeStep);
+		}
+		else
+		{
+			Cores.Visit(bStateDoublePrecision, [this, &TimeStep, NumSubsteps](auto& Core)
+			{
+				for (int32 Substep = 0; Substep < NumSubsteps; ++Substep)
+				{
+					if (Substep == NumSubsteps - 1)
+					{
+						for (int32 i = 0; i < Core.State.Num(); ++i)
+						{
+							PreviousPositions[i] = Core.GetWorldPosition(i);
+						}
+					}
+					Core.Step(TimeStep);
+				}
+			});
+		}
+
+		if (GravitySolver == EGravitySolver::BarnesHut && bReportSolverError && ++SolverErrorReportCounter >= SolverErrorReportInterval)
+		{
+			SolverErrorReportCounter = 0;
+			ReportSolverError();
+		}
+		
+		ScatterState(Bodies, InterpolationAlpha);
 	}
 	else
 	{
@@ -44,65 +216,284 @@ void AOrbitSimulation::UpdateAllObjects(const float& TimeStep) const
 	
 }
 
-void AOrbitSimulation::UpdateAllPositions(const float& TimeStep) const
+void AOrbitSimulation::UpdateAllPositions(const TArray<ACelestialBody*>& Bodies, const float& TimeStep) const
 {
-	for (const auto& Body : CelestialBodyRegistry->GetCelestialObjects())
+	for (const auto& Body : Bodies)
 	{
 		Body->UpdatePosition(TimeStep);
 	}
 }
 
-void AOrbitSimulation::UpdateAllVelocities(const float& TimeStep) const
+void AOrbitSimulation::UpdateAllVelocities(const float& TimeStep)
 {
-	for (const auto& Body : CelestialBodyRegistry->GetCelestialObjects())
+	Cores.Visit(bStateDoublePrecision, [this, &TimeStep](auto& Core)
 	{
-		FVector Acceleration = CalculateGravitationalAcceleration(Body->GetActorLocation(), Body);
-		Body->UpdateVelocity(Acceleration, TimeStep);
-	}
+		Core.CalculateAccelerations();
+		
+		for (int32 i = 0; i < Core.State.Num(); ++i)
+		{
+			Core.State.SetVelocity(i, Core.State.GetVelocity(i) + Core.State.GetAcceleration(i) * TimeStep);
+		}
+		
+		// The physics engine only moves the actors, the particle bodies take the position half of the Euler step here
+		for (int32 FieldIndex = 0; FieldIndex < StateFields.Num(); ++FieldIndex)
+		{
+			const int32 FirstIndex = FieldStateIndices[FieldIndex];
+			for (int32 i = FirstIndex; i < FirstIndex + StateFields[FieldIndex]->GetNumBodies(); ++i)
+			{
+				Core.SetWorldPosition(i, Core.GetWorldPosition(i) + Core.State.GetVelocity(i) * TimeStep);
+			}
+		}
+	});
 }
 
 /**
- * Calculates the gravitational acceleration towards an object.
+ * Reads the positions and masses of all bodies into the state arrays. This is the only place per tick where
+ * the simulation touches the actors for reading. The positions and velocities are owned by the simulation.
+ * When the set of bodies changes, the bodies that were simulated before keep their state and only new bodies
+ * are read from their actors, whose rendered locations may lag behind the simulation. The positions are read
+ * every tick when the physics engine moves the bodies.
  *
- * This function calculates the gravitational acceleration vector pointing towards a specified celestial object.
- * It assumes the object is within a uniform gravitational field influenced by the specified object's mass.
+ * The bodies of the particle fields are owned by the simulation entirely. Only the bodies of a field that
+ * joined are read from it, they start at the initial conditions of the field.
+ */
+void AOrbitSimulation::GatherState(const TArray<ACelestialBody*>& Bodies, const TArray<AParticleBodyField*>& Fields)
+{
+	const bool bBodiesChanged = StateBodies != Bodies || StateFields != Fields || bStateDoublePrecision != bDoublePrecision;
+	int32 NumSources = 0;
+	FCarriedState Carried;
+	if (bBodiesChanged)
+	{
+		Carried = CarryState();
+		StateBodies = Bodies;
+		StateFields = Fields;
+		bStateDoublePrecision = bDoublePrecision;
+		NumSources = AssignStateIndices();
+	}
+	
+	Cores.Visit(bStateDoublePrecision, [this, &Bodies, &Fields, &Carried, bBodiesChanged, NumSources](auto& Core)
+	{
+		Core.Settings = GetSimulationSettings();
+		if (bBodiesChanged)
+		{
+			Core.State.SetNum(PreviousPositions.Num());
+			Core.State.NumSources = NumSources;
+			Core.Invalidate();
+			
+			// The positions are stored relative to the heaviest celestial body right away, before they lose any precision
+			const ACelestialBody* const* HeaviestBody = Algo::MaxElementBy(Bodies, &ACelestialBody::GetMass);
+			Core.Origin = bFloatingOrigin && HeaviestBody ? (*HeaviestBody)->GetActorLocation() : FVector::ZeroVector;
+		}
+		
+		for (int32 i = 0; i < Bodies.Num(); ++i)
+		{
+			ACelestialBody* Body = Bodies[i];
+			const int32 StateIndex = BodyStateIndices[i];
+			Body->SetKinematic(bKinematicBodies);
+			Core.State.Mass[StateIndex] = Body->GetMass();
+			
+			const int32* OldIndex = bBodiesChanged ? Carried.BodyIndices.Find(Body) : nullptr;
+			if (OldIndex && !IsPhysicsDriven())
+			{
+				Core.SetWorldPosition(StateIndex, Carried.Positions[*OldIndex]);
+				PreviousPositions[StateIndex] = Carried.PreviousPositions[*OldIndex];
+			}
+			else if (bBodiesChanged || IsPhysicsDriven())
+			{
+				Core.SetWorldPosition(StateIndex, Body->GetActorLocation());
+				PreviousPositions[StateIndex] = Body->GetActorLocation();
+			}
+			if (bBodiesChanged)
+			{
+				Core.State.SetVelocity(StateIndex, OldIndex ? Carried.Velocities[*OldIndex] : Body->GetCurrentVelocity());
+			}
+		}
+		
+		if (!bBodiesChanged) return;
+		
+		for (int32 FieldIndex = 0; FieldIndex < Fields.Num(); ++FieldIndex)
+		{
+			const AParticleBodyField* Field = Fields[FieldIndex];
+			const int32* OldFirstIndex = Carried.FieldIndices.Find(Field);
+			for (int32 i = 0; i < Field->GetNumBodies(); ++i)
+			{
+				const int32 StateIndex = FieldStateIndices[FieldIndex] + i;
+				Core.State.Mass[StateIndex] = Field->GetMass(i);
+				if (OldFirstIndex)
+				{
+					Core.SetWorldPosition(StateIndex, Carried.Positions[*OldFirstIndex + i]);
+					Core.State.SetVelocity(StateIndex, Carried.Velocities[*OldFirstIndex + i]);
+					PreviousPositions[StateIndex] = Carried.PreviousPositions[*OldFirstIndex + i];
+				}
+				else
+				{
+					Core.SetWorldPosition(StateIndex, Field->GetInitialPosition(i));
+					Core.State.SetVelocity(StateIndex, Field->GetInitialVelocity(i));
+					PreviousPositions[StateIndex] = Field->GetInitialPosition(i);
+				}
+			}
+		}
+
+		// The heaviest celestial body is only a first guess. The origin follows the body the core picks from the
+		// whole state, which may belong to a particle field.
+		if (bFloatingOrigin)
+		{
+			Core.Recenter();
+		}
+	});
+}
+
+/**
+ * Copies the world positions and velocities out of the state before it is reordered for a new set of bodies.
+ * It is read from the core of the old precision, so switching the precision keeps the bodies where they are.
+ */
+AOrbitSimulation::FCarriedState AOrbitSimulation::CarryState() const
+{
+	FCarriedState Carried;
+	Cores.Visit(bStateDoublePrecision, [this, &Carried](const auto& Core)
+	{
+		const int32 Num = Core.State.Num();
+		if (Num != PreviousPositions.Num()) return;
+		
+		Carried.Positions.SetNumUninitialized(Num);
+		Carried.Velocities.SetNumUninitialized(Num);
+		for (int32 i = 0; i < Num; ++i)
+		{
+			Carried.Positions[i] = Core.GetWorldPosition(i);
+			Carried.Velocities[i] = Core.State.GetVelocity(i);
+		}
+		Carried.PreviousPositions = PreviousPositions;
+		
+		Carried.BodyIndices.Reserve(StateBodies.Num());
+		for (int32 i = 0; i < StateBodies.Num(); ++i)
+		{
+			Carried.BodyIndices.Add(StateBodies[i], BodyStateIndices[i]);
+		}
+		
+		// A field keeps its bodies once they are generated, so its old range still matches it
+		for (int32 i = 0; i < StateFields.Num(); ++i)
+		{
+			if (StateFields[i] && FieldStateIndices[i] + StateFields[i]->GetNumBodies() <= Num)
+			{
+				Carried.FieldIndices.Add(StateFields[i], FieldStateIndices[i]);
+			}
+		}
+	});
+	return Carried;
+}
+
+/**
+ * Orders the state so that all bodies with mass come first and the massless tracers last. The gravity solvers
+ * only sum over the first part, so the tracers cost O(N_massive) each instead of O(N).
  *
- * @param OtherPosition The position of the object experiencing the gravitational force.
- * @param Object The celestial object exerting the gravitational force.
- * @return FVector The calculated gravitational acceleration vector.
+ * @return int32 The number of bodies that exert gravity.
  */
-FVector AOrbitSimulation::CalculateGravitationalAcceleration(const FVector& OtherPosition, const ACelestialBody* Object) const
-{
-	// If one mass is much larger than the other, it is convenient to take it as observational reference and define
-	// it as source of a gravitational field of magnitude and orientation. The larger mass is virtually stationary.
-	// The assumption for the calculation of the gravitational effect is used for smaller objects in the reference system.
-	// The smaller mass moves under the influence of the gravitational field of the larger mass.
-	// g = G * M / r^2 | Gravitational acceleration
-	// https://en.wikipedia.org/wiki/Gravitational_acceleration | Details and history of the formula
+int32 AOrbitSimulation::AssignStateIndices()
+{
+	BodyStateIndices.SetNumUninitialized(StateBodies.Num());
+	FieldStateIndices.SetNumUninitialized(StateFields.Num());
 	
-	FVector Acceleration = FVector::ZeroVector;
-	for (const auto& Obj : CelestialBodyRegistry->GetCelestialObjects())
-	{
-		if (Obj == Object) continue;
-
-		// Gravitational constant G
-		constexpr float G = FUniverse::GravitationalConstant;
-		// Mass of the sample object m
-		const float M = Obj->GetMass();
-		// Distance between two objects r = |r1 - r2| r = R
-		FVector R = Obj->GetActorLocation() - OtherPosition;
-		// Distance squared
-		const float SqrR = R.SizeSquared();
-		// Direction of the force
-		FVector ForceDir = R.GetSafeNormal();
-
-		// Superposition of all gravitational forces:
-		// The vectorial sum of all gravitational accelerations emanating from each object in the
-		// field is formed to determine the total acceleration of the object under consideration.
-		Acceleration += ForceDir * G * M / SqrR;
-	}
+	int32 NextIndex = 0;
+	auto AssignIndices = [this, &NextIndex](const bool bTracers)
+	{
+		for (int32 i = 0; i < StateBodies.Num(); ++i)
+		{
+			if (StateBodies[i]->IsMasslessTracer() != bTracers) continue;
+			BodyStateIndices[i] = NextIndex++;
+		}
+		for (int32 i = 0; i < StateFields.Num(); ++i)
+		{
+			if (StateFields[i]->AreMasslessTracers() != bTracers) continue;
+			FieldStateIndices[i] = NextIndex;
+			NextIndex += StateFields[i]->GetNumBodies();
+		}
+	};
 	
-	return Acceleration;
+	AssignIndices(false);
+	const int32 NumSources = NextIndex;
+	AssignIndices(true);
+	
+	PreviousPositions.SetNumUninitialized(NextIndex);
+	return NumSources;
+}
+
+/**
+ * Writes the integrated velocities, and the positions if the integrator owns them, back to the bodies once per tick.
+ * All transforms are written in this single pass after the integration, never from inside the integrator stages.
+ * The written positions are interpolated between the last two steps, the state itself is left untouched.
+ */
+void AOrbitSimulation::ScatterState(const TArray<ACelestialBody*>& Bodies, const float InterpolationAlpha) const
+{
+	const bool bWritePositions = !IsPhysicsDriven();
+	Cores.Visit(bStateDoublePrecision, [this, &Bodies, InterpolationAlpha, bWritePositions](const auto& Core)
+	{
+		auto GetLocation = [this, &Core, InterpolationAlpha](const int32 StateIndex)
+		{
+			const FVector Position = Core.GetWorldPosition(StateIndex);
+			return InterpolationAlpha < 1.0f ? FMath::Lerp(PreviousPositions[StateIndex], Position, InterpolationAlpha) : Position;
+		};
+		
+		for (int32 i = 0; i < Bodies.Num(); ++i)
+		{
+			const int32 StateIndex = BodyStateIndices[i];
+			Bodies[i]->SetCurrentVelocity(Core.State.GetVelocity(StateIndex));
+			
+			if (bWritePositions)
+			{
+				Bodies[i]->SetSimulatedLocation(GetLocation(StateIndex));
+			}
+		}
+		
+		ScatterFields(GetLocation);
+	});
+}
+
+/**
+ * Moves the instances of all particle fields, one batch per field.
+ *
+ * @param GetLocation Returns the world location of a body by its index in the state.
+ */
+void AOrbitSimulation::ScatterFields(const TFunctionRef<FVector(int32 StateIndex)> GetLocation) const
+{
+	for (int32 FieldIndex = 0; FieldIndex < StateFields.Num(); ++FieldIndex)
+	{
+		const int32 FirstIndex = FieldStateIndices[FieldIndex];
+		StateFields[FieldIndex]->UpdateInstances([&GetLocation, FirstIndex](const int Index) { return GetLocation(FirstIndex + Index); });
+	}
+}
+
+/**
+ * Compares the accelerations of the approximating solver with the exact direct sum and logs the
+ * maximum and root mean square relative error over all bodies.
+ */
+void AOrbitSimulation::ReportSolverError()
+{
+	Cores.Visit(bStateDoublePrecision, [this](auto& Core)
+	{
+		const auto& State = Core.State;
+		if (State.Num() == 0) return;
+		
+		// The accelerations in the state may belong to an intermediate stage of the integrator
+		Core.BarnesHut.Prepare(State, Core.Settings, nullptr);
+		const TGravitySources Sources(State);
+		
+		double MaxRelativeError = 0.0;
+		double SumSqrRelativeError = 0.0;
+		for (int32 i = 0; i < State.Num(); ++i)
+		{
+			const FVector Exact = Core.DirectSum.CalculateAcceleration(State, Sources, i, Core.Settings);
+			const double ExactSize = Exact.Size();
+			if (ExactSize <= SMALL_NUMBER) continue;
+			
+			const FVector Approximated = Core.BarnesHut.CalculateAcceleration(State, Sources, i, Core.Settings);
+			const double RelativeError = (Approximated - Exact).Size() / ExactSize;
+			MaxRelativeError = FMath::Max(MaxRelativeError, RelativeError);
+			SumSqrRelativeError += RelativeError * RelativeError;
+		}
+		
+		LOG_DISPLAY_F("Barnes-Hut (theta = %.2f, %d nodes) relative error: max %.3e, rms %.3e", OpeningAngle,
+			Core.BarnesHut.Tree.GetNumNodes(), MaxRelativeError, FMath::Sqrt(SumSqrRelativeError / State.Num()));
+	});
 }
 
 void AOrbitSimulation::GetCelestialBodyRegistry()
@@ -5,7 +5,13 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "ACelestialBodyRegistry.h"
+#include "OrbitSimulationCore.h"
+#include "OrbitSimulationThread.h"
 #include "SolarSystem/CelestialBody/CelestialBody.h"
+#include "SolarSystem/CelestialBody/ParticleBodyField.h"
+#include "SolarSystem/Structs/GravitySolver.h"
+#include "SolarSystem/Structs/OrbitIntegrator.h"
+#include "SolarSystem/Structs/OrbitState.h"
 #include "OrbitSimulation.generated.h"
 
 /**
@@ -21,6 +27,7 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaTime) override;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
@@ -29,15 +36,141 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
 	float TimeScale;
 
+	// Steps the simulation at a fixed rate of real time instead of once per frame and interpolates the rendered
+	// locations between the last two steps. Only used when the integrator owns the positions.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (EditCondition = "!bLegacyPhysicsMovement || bKinematicBodies"))
+	bool bFixedTimestep;
+
+	// Runs the integration on a dedicated thread at the fixed step rate. The game thread only writes the latest
+	// published step to the bodies. Only used when the integrator owns the positions.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (EditCondition = "!bLegacyPhysicsMovement || bKinematicBodies"))
+	bool bSimulationThread;
+
+	// Simulation steps per second of real time. Every step advances the simulation by the universe time step.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "1.0", EditCondition = "bFixedTimestep || bSimulationThread"))
+	float FixedStepRate;
+
+	// Upper limit of the steps per frame, so a slow frame does not make the next one even slower.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "1", EditCondition = "bFixedTimestep"))
+	int MaxSubstepsPerFrame;
+
+	// Keeps the time that exceeded the substep limit and catches up on it over the next frames, at most one more
+	// frame of substeps. Otherwise the time is dropped and the simulation slows down instead.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (EditCondition = "bFixedTimestep"))
+	bool bCatchUpDroppedTime;
+
+	// The integrator owns the positions and moves the bodies directly, the orbit debugger predicts with the same one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (EditCondition = "!bLegacyPhysicsMovement || bKinematicBodies"))
+	EOrbitIntegrator Integrator;
+
+	// Legacy behavior: semi-implicit Euler whose position half is left to the physics engine, which moves the
+	// bodies with their velocities once per frame. The preview cannot reproduce it, and fixed timesteps and the
+	// simulation thread are not available.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", AdvancedDisplay)
+	bool bLegacyPhysicsMovement;
+
+	// Takes the bodies out of the physics scene and moves them without rigid body teleports. Overrides the
+	// legacy physics movement, the result no longer depends on the physics engine.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
+	bool bKinematicBodies;
+
+	// Integrates in double precision, for systems at real scale where float loses the small distances next to
+	// the large ones. Roughly halves the throughput of the gravity solver.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
+	bool bDoublePrecision;
+
+	// Stores the positions relative to the heaviest body and moves that origin along with it.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
+	bool bFloatingOrigin;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
+	EGravitySolver GravitySolver;
+
+	// Barnes-Hut opening angle theta. Smaller values are more accurate, 0 equals the direct sum.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "0.0", ClampMax = "2.0", EditCondition = "GravitySolver == EGravitySolver::BarnesHut"))
+	float OpeningAngle;
+
+	// Plummer softening length. Removes the singularity when two bodies get close, 0 disables softening.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "0.0"))
+	float SofteningLength;
+
+	// Deepest level of the adaptive block timesteps. A body on level L takes 2^L substeps per tick. Every substep
+	// evaluates the bodies that end one, with Barnes-Hut it refits the tree, and once per tick the tree is rebuilt.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "0", ClampMax = "16", EditCondition = "Integrator == EOrbitIntegrator::AdaptiveBlockLeapfrog"))
+	int MaxTimestepLevel;
+
+	// Distance a body may fall freely within one of its substeps. Smaller values give more substeps to bodies with high accelerations.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "0.001", EditCondition = "Integrator == EOrbitIntegrator::AdaptiveBlockLeapfrog"))
+	float TimestepAccuracy;
+
+	// Spreads the force calculation over the worker threads. The result is identical to the single-threaded one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics")
+	bool bParallelForces;
+
+	// Number of bodies per parallel task. Small batches balance better, large batches have less overhead.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Physics", meta = (ClampMin = "1", EditCondition = "bParallelForces"))
+	int ParallelBatchSize;
+
+	// Periodically compares the Barnes-Hut result with the direct sum and logs the relative error.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug Options", meta = (EditCondition = "GravitySolver == EGravitySolver::BarnesHut"))
+	bool bReportSolverError;
+
+	// Number of ticks between two error reports.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Debug Options", meta = (ClampMin = "1", EditCondition = "bReportSolverError"))
+	int SolverErrorReportInterval;
+
 	UPROPERTY()
 	ACelestialBodyRegistry* CelestialBodyRegistry;
 private:
+	UPROPERTY()
+	TArray<ACelestialBody*> StateBodies;
+	UPROPERTY()
+	TArray<AParticleBodyField*> StateFields;
+	// Index in the state of every celestial body, and of the first body of every particle field
+	TArray<int32> BodyStateIndices;
+	TArray<int32> FieldStateIndices;
+
+	FOrbitSimulationCores Cores;
+	// Precision of the core the state was gathered into
+	bool bStateDoublePrecision = false;
+	int SolverErrorReportCounter = 0;
+
+	// Real time that was not yet simulated by a fixed step
+	float TimeAccumulator = 0.0f;
+	// World positions before the last step, the start of the render interpolation
+	TArray<FVector> PreviousPositions;
+
+	TUniquePtr<FOrbitSimulationThread> SimulationThread;
+
+	// The world positions and velocities of the simulated bodies, kept while the state is reordered for a new set of bodies
+	struct FCarriedState
+	{
+		// The old state index of every celestial body, and of the first body of every particle field
+		TMap<const ACelestialBody*, int32> BodyIndices;
+		TMap<const AParticleBodyField*, int32> FieldIndices;
+		TArray<FVector> Positions;
+		TArray<FVector> Velocities;
+		TArray<FVector> PreviousPositions;
+	};
+
+	void TickFixedTimestep(const float DeltaTime);
+	void TickSimulationThread();
+	void StopSimulationThread();
+	FOrbitSimulationSettings GetSimulationSettings() const;
+	FOrbitSimulationThreadSettings GetSimulationThreadSettings() const;
+	void UpdateAllObjects(const float& TimeStep, const int32 NumSubsteps = 1, const float InterpolationAlpha = 1.0f);
+	void UpdateAllPositions(const TArray<ACelestialBody*>& Bodies, const float& TimeStep) const;
+	void UpdateAllVelocities(const float& TimeStep);
+
+	void GatherState(const TArray<ACelestialBody*>& Bodies, const TArray<AParticleBodyField*>& Fields);
+	void ScatterState(const TArray<ACelestialBody*>& Bodies, const float InterpolationAlpha) const;
+	int32 AssignStateIndices();
+	FCarriedState CarryState() const;
+	void ScatterFields(const TFunctionRef<FVector(int32 StateIndex)> GetLocation) const;
 
-	void UpdateAllObjects(const float& TimeStep) const;
-	void UpdateAllPositions(const float& TimeStep) const;
-	void UpdateAllVelocities(const float& TimeStep) const;
+	void ReportSolverError();
 
-	FVector CalculateGravitationalAcceleration(const FVector& OtherPosition, const ACelestialBody* Object) const;
+	bool IsPhysicsDriven() const { return bLegacyPhysicsMovement && !bKinematicBodies; }
 	
 	void GetCelestialBodyRegistry();
 };
@@ -0,0 +1,127 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "OrbitSimulationCore.h"
+
+#include "Async/ParallelFor.h"
+
+
+template <typename ScalarType>
+FVector OrbitSolvers::TDirectSum<ScalarType>::CalculateAcceleration(const TOrbitState<ScalarType>& State,
+	const TGravitySources<ScalarType>& Sources, const int32 BodyIndex, const FOrbitSimulationSettings& Settings) const
+{
+	// If one mass is much larger than the other, it is convenient to take it as observational reference and define
+	// it as source of a gravitational field of magnitude and orientation. The larger mass is virtually stationary.
+	// The assumption for the calculation of the gravitational effect is used for smaller objects in the reference system.
+	// The smaller mass moves under the influence of the gravitational field of the larger mass.
+	// g = G * M / r^2 | Gravitational acceleration
+	// https://en.wikipedia.org/wiki/Gravitational_acceleration | Details and history of the formula
+
+	// Superposition of all gravitational forces:
+	// The vectorial sum of all gravitational accelerations emanating from each object in the
+	// field is formed to determine the total acceleration of the object under consideration.
+	return GravityKernel::CalculateAcceleration(Sources, State.GetPosition(BodyIndex), BodyIndex,
+		static_cast<ScalarType>(Settings.SofteningLength) * Settings.SofteningLength);
+}
+
+template <typename ScalarType>
+FVector OrbitSolvers::TBarnesHut<ScalarType>::CalculateAcceleration(const TOrbitState<ScalarType>& State,
+	const TGravitySources<ScalarType>& Sources, const int32 BodyIndex, const FOrbitSimulationSettings& Settings) const
+{
+	return Tree.CalculateAcceleration(State, BodyIndex, Settings.OpeningAngle,
+		static_cast<ScalarType>(Settings.SofteningLength) * Settings.SofteningLength);
+}
+
+template <typename ScalarType>
+void TOrbitSimulationCore<ScalarType>::Step(const float TimeStep)
+{
+	IntegratorContext.MaxTimestepLevel = Settings.MaxTimestepLevel;
+	IntegratorContext.TimestepAccuracy = Settings.TimestepAccuracy;
+	OrbitIntegration::Step<ScalarType>(Settings.Integrator, State, TimeStep,
+		[this](TOrbitState<ScalarType>&, const TArray<int32>* Targets) { CalculateAccelerations(Targets); }, IntegratorContext);
+
+	if (Settings.bFloatingOrigin)
+	{
+		Recenter();
+	}
+}
+
+template <typename ScalarType>
+void TOrbitSimulationCore<ScalarType>::CalculateAccelerations(const TArray<int32>* Targets)
+{
+	switch (Settings.GravitySolver)
+	{
+	case OrbitCore::ESolver::DirectSum:
+		CalculateAccelerations(DirectSum, Targets);
+		break;
+	case OrbitCore::ESolver::BarnesHut:
+		CalculateAccelerations(BarnesHut, Targets);
+		break;
+	}
+}
+
+template <typename ScalarType>
+void TOrbitSimulationCore<ScalarType>::Recenter()
+{
+	if (State.Num() == 0) return;
+
+	const int32 OriginBody = FindOriginBody();
+
+	// A translation changes no distance, so the accelerations an integrator reuses stay valid
+	const ScalarType ShiftX = State.PositionX[OriginBody];
+	const ScalarType ShiftY = State.PositionY[OriginBody];
+	const ScalarType ShiftZ = State.PositionZ[OriginBody];
+	for (int32 i = 0; i < State.Num(); ++i)
+	{
+		State.PositionX[i] -= ShiftX;
+		State.PositionY[i] -= ShiftY;
+		State.PositionZ[i] -= ShiftZ;
+	}
+	Origin += FVector(ShiftX, ShiftY, ShiftZ);
+}
+
+template <typename ScalarType>
+int32 TOrbitSimulationCore<ScalarType>::FindOriginBody() const
+{
+	int32 OriginBody = 0;
+	for (int32 i = 1; i < State.Num(); ++i)
+	{
+		if (State.Mass[i] > State.Mass[OriginBody])
+		{
+			OriginBody = i;
+		}
+	}
+	return OriginBody;
+}
+
+template <typename ScalarType>
+template <typename SolverType>
+void TOrbitSimulationCore<ScalarType>::CalculateAccelerations(SolverType& Solver, const TArray<int32>* Targets)
+{
+	Solver.Prepare(State, Settings, Targets);
+
+	const TGravitySources<ScalarType> Sources(State);
+	const int32 NumTargets = Targets ? Targets->Num() : State.Num();
+	const int32 BatchSize = Settings.ParallelBatchSize > 0 ? Settings.ParallelBatchSize : FMath::Max(NumTargets, 1);
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumTargets, BatchSize);
+
+	// Every body sums up its sources in a fixed order and only writes its own acceleration, so there is no
+	// shared reduction and the result is bit-identical no matter how the batches are spread over the threads.
+	ParallelFor(NumBatches, [this, &Solver, &Sources, Targets, NumTargets, BatchSize](const int32 BatchIndex)
+	{
+		const int32 Begin = BatchIndex * BatchSize;
+		const int32 End = FMath::Min(Begin + BatchSize, NumTargets);
+		for (int32 TargetIndex = Begin; TargetIndex < End; ++TargetIndex)
+		{
+			const int32 i = Targets ? (*Targets)[TargetIndex] : TargetIndex;
+			State.SetAcceleration(i, Solver.CalculateAcceleration(State, Sources, i, Settings));
+		}
+	}, NumBatches < 2);
+}
+
+template struct OrbitSolvers::TDirectSum<float>;
+template struct OrbitSolvers::TDirectSum<double>;
+template struct OrbitSolvers::TBarnesHut<float>;
+template struct OrbitSolvers::TBarnesHut<double>;
+template class TOrbitSimulationCore<float>;
+template class TOrbitSimulationCore<double>;
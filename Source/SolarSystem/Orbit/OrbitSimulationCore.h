@@ -0,0 +1,176 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BarnesHutTree.h"
+#include "GravityKernel.h"
+#include "OrbitIntegration.h"
+#include "SolarSystem/Structs/OrbitCoreTypes.h"
+#include "SolarSystem/Structs/OrbitState.h"
+
+/**
+ * The parameters that decide how the orbit state is advanced. Equal settings give equal trajectories,
+ * no matter if the core runs in the game, on the simulation thread, in the editor preview or headless.
+ */
+struct FOrbitSimulationSettings
+{
+	OrbitCore::EIntegrator Integrator = OrbitCore::EIntegrator::VelocityVerlet;
+	OrbitCore::ESolver GravitySolver = OrbitCore::ESolver::DirectSum;
+	float OpeningAngle = 0.5f;
+	float SofteningLength = 0.0f;
+	int32 MaxTimestepLevel = 6;
+	float TimestepAccuracy = 10.0f;
+	// Number of bodies per parallel task, 0 evaluates the forces on the calling thread only
+	int32 ParallelBatchSize = 0;
+	// Integrates in double instead of float precision
+	bool bDoublePrecision = false;
+	// Keeps the heaviest body at the origin of the state, so the positions stay small next to it
+	bool bFloatingOrigin = false;
+
+	bool operator==(const FOrbitSimulationSettings& Other) const
+	{
+		return Integrator == Other.Integrator && GravitySolver == Other.GravitySolver && OpeningAngle == Other.OpeningAngle
+			&& SofteningLength == Other.SofteningLength && MaxTimestepLevel == Other.MaxTimestepLevel
+			&& TimestepAccuracy == Other.TimestepAccuracy && ParallelBatchSize == Other.ParallelBatchSize
+			&& bDoublePrecision == Other.bDoublePrecision && bFloatingOrigin == Other.bFloatingOrigin;
+	}
+	bool operator!=(const FOrbitSimulationSettings& Other) const { return !(*this == Other); }
+};
+
+/**
+ * Force solver policies of the simulation core. A solver is prepared once per force evaluation with the bodies
+ * that are evaluated, nullptr for all, and then asked for the acceleration of single bodies, possibly from
+ * several threads at once.
+ */
+namespace OrbitSolvers
+{
+	// Exact O(N^2) sum over all bodies
+	template <typename ScalarType>
+	struct TDirectSum
+	{
+		void Prepare(const TOrbitState<ScalarType>& State, const FOrbitSimulationSettings& Settings, const TArray<int32>* Targets) {}
+		FVector CalculateAcceleration(const TOrbitState<ScalarType>& State, const TGravitySources<ScalarType>& Sources,
+			const int32 BodyIndex, const FOrbitSimulationSettings& Settings) const;
+	};
+
+	// O(N log N) approximation over an octree. The tree is rebuilt for every evaluation of all bodies. The
+	// substeps of the adaptive block leapfrog only evaluate some bodies and refit it instead, the last substep
+	// of a step evaluates all bodies again, so the cells are rebuilt once per step.
+	template <typename ScalarType>
+	struct TBarnesHut
+	{
+		TBarnesHutTree<ScalarType> Tree;
+
+		void Prepare(const TOrbitState<ScalarType>& State, const FOrbitSimulationSettings& Settings, const TArray<int32>* Targets)
+		{
+			if (Targets && Targets->Num() < State.Num())
+			{
+				Tree.Refit(State);
+			}
+			else
+			{
+				Tree.Build(State);
+			}
+		}
+		FVector CalculateAcceleration(const TOrbitState<ScalarType>& State, const TGravitySources<ScalarType>& Sources,
+			const int32 BodyIndex, const FOrbitSimulationSettings& Settings) const;
+	};
+}
+
+/**
+ * The one simulation core used by the runtime simulation, the simulation thread, the editor orbit prediction
+ * and the headless commandlet. It owns the state and advances it with the integrator and gravity solver of
+ * its settings, so every optimization applies everywhere. With equal settings the preview matches the game,
+ * except in the legacy mode of the orbit simulation that leaves the positions to the physics engine.
+ *
+ * The state positions are relative to the origin. Without a floating origin it stays at zero, with one it
+ * follows the heaviest body, which keeps the float positions of a heliocentric system precise.
+ */
+template <typename ScalarType>
+class TOrbitSimulationCore
+{
+public:
+	TOrbitState<ScalarType> State;
+	FOrbitSimulationSettings Settings;
+	// World position of the state origin
+	FVector Origin = FVector::ZeroVector;
+
+	OrbitSolvers::TDirectSum<ScalarType> DirectSum;
+	OrbitSolvers::TBarnesHut<ScalarType> BarnesHut;
+
+	/**
+	 * Advances the state by one time step with the integrator of the settings.
+	 */
+	void Step(const float TimeStep);
+
+	/**
+	 * Fills the accelerations of the target bodies with the gravity solver of the settings.
+	 *
+	 * @param Targets The bodies to evaluate, nullptr for all bodies. The sources are always all bodies.
+	 */
+	void CalculateAccelerations(const TArray<int32>* Targets = nullptr);
+
+	/**
+	 * Moves the origin onto the heaviest body. The positions are shifted by the same amount, the physics is unchanged.
+	 */
+	void Recenter();
+
+	/**
+	 * The body the floating origin follows: the heaviest of the whole state, the first one of equal masses.
+	 */
+	int32 FindOriginBody() const;
+
+	/**
+	 * Forgets the accelerations an integrator may reuse. Call it whenever the state was changed from outside.
+	 */
+	void Invalidate() { IntegratorContext.Invalidate(); }
+
+	/**
+	 * Memory held by the state and the scratch data of the integrator and the solvers. A warmed up core steps
+	 * without changing it.
+	 */
+	SIZE_T GetAllocatedSize() const
+	{
+		return State.GetAllocatedSize() + BarnesHut.Tree.GetAllocatedSize() + IntegratorContext.GetAllocatedSize();
+	}
+
+	FVector GetWorldPosition(const int32 Index) const { return Origin + State.GetPosition(Index); }
+	void SetWorldPosition(const int32 Index, const FVector& Position) { State.SetPosition(Index, Position - Origin); }
+
+private:
+	TOrbitIntegratorContext<ScalarType> IntegratorContext;
+
+	template <typename SolverType>
+	void CalculateAccelerations(SolverType& Solver, const TArray<int32>* Targets);
+};
+
+using FOrbitSimulationCore = TOrbitSimulationCore<float>;
+using FOrbitSimulationCoreDouble = TOrbitSimulationCore<double>;
+
+/**
+ * A float and a double core, of which the settings choose one. Owners that let the user pick the precision
+ * hold this and run their code on the active core with Visit.
+ */
+struct FOrbitSimulationCores
+{
+	FOrbitSimulationCore Float;
+	FOrbitSimulationCoreDouble Double;
+
+	/**
+	 * Calls the function with the core of the chosen precision.
+	 */
+	template <typename FunctionType>
+	decltype(auto) Visit(const bool bDoublePrecision, FunctionType&& Function)
+	{
+		return bDoublePrecision ? Function(Double) : Function(Float);
+	}
+
+	template <typename FunctionType>
+	decltype(auto) Visit(const bool bDoublePrecision, FunctionType&& Function) const
+	{
+		return bDoublePrecision ? Function(Double) : Function(Float);
+	}
+
+	SIZE_T GetAllocatedSize() const { return Float.GetAllocatedSize() + Double.GetAllocatedSize(); }
+};
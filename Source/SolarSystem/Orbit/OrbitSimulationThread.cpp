@@ -0,0 +1,100 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "OrbitSimulationThread.h"
+
+#include "HAL/RunnableThread.h"
+
+
+FOrbitSimulationThread::FOrbitSimulationThread(const FOrbitSimulationCores& InitialCores, const FOrbitSimulationThreadSettings& InSettings)
+	: Settings(InSettings)
+{
+	if (Settings.Simulation.bDoublePrecision)
+	{
+		Cores.Double = InitialCores.Double;
+	}
+	else
+	{
+		Cores.Float = InitialCores.Float;
+	}
+	Cores.Visit(Settings.Simulation.bDoublePrecision, [this](auto& Core)
+	{
+		Core.Settings = Settings.Simulation;
+		Core.Invalidate();
+	});
+
+	Thread = FRunnableThread::Create(this, TEXT("OrbitSimulationThread"), 0, TPri_Normal);
+}
+
+FOrbitSimulationThread::~FOrbitSimulationThread()
+{
+	Shutdown();
+}
+
+uint32 FOrbitSimulationThread::Run()
+{
+	const double StepInterval = 1.0 / FMath::Max(Settings.StepRate, 1.0f);
+	double NextStepTime = FPlatformTime::Seconds();
+
+	while (!bStopping)
+	{
+		Cores.Visit(Settings.Simulation.bDoublePrecision, [this](auto& Core) { Core.Step(Settings.TimeStep); });
+		++NumSteps;
+		PublishSnapshot();
+
+		// Keeps the step rate, a thread that fell behind continues from now instead of racing to catch up
+		NextStepTime += StepInterval;
+		const double Now = FPlatformTime::Seconds();
+		if (NextStepTime > Now)
+		{
+			FPlatformProcess::Sleep(static_cast<float>(NextStepTime - Now));
+		}
+		else
+		{
+			NextStepTime = Now;
+		}
+	}
+
+	return 0;
+}
+
+void FOrbitSimulationThread::Stop()
+{
+	bStopping = true;
+}
+
+void FOrbitSimulationThread::Shutdown()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+const FOrbitSnapshot* FOrbitSimulationThread::ReadSnapshot()
+{
+	if (!Snapshots.IsDirty()) return nullptr;
+
+	Snapshots.SwapReadBuffers();
+	return &Snapshots.Read();
+}
+
+void FOrbitSimulationThread::PublishSnapshot()
+{
+	// The write buffer is only touched by this thread, the arrays keep their allocation after the first steps
+	FOrbitSnapshot& Snapshot = Snapshots.GetWriteBuffer();
+	Cores.Visit(Settings.Simulation.bDoublePrecision, [&Snapshot](const auto& Core)
+	{
+		Snapshot.Positions.SetNumUninitialized(Core.State.Num());
+		Snapshot.Velocities.SetNumUninitialized(Core.State.Num());
+		for (int32 i = 0; i < Core.State.Num(); ++i)
+		{
+			Snapshot.Positions[i] = Core.GetWorldPosition(i);
+			Snapshot.Velocities[i] = Core.State.GetVelocity(i);
+		}
+	});
+	Snapshot.NumSteps = NumSteps;
+	Snapshots.SwapWriteBuffers();
+}
@@ -0,0 +1,82 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OrbitSimulationCore.h"
+#include "Containers/TripleBuffer.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+
+/**
+ * The parameters a simulation thread runs with. They are fixed for the lifetime of the thread.
+ */
+struct FOrbitSimulationThreadSettings
+{
+	FOrbitSimulationSettings Simulation;
+	// Simulated time per step
+	float TimeStep = 0.0f;
+	// Steps per second of real time
+	float StepRate = 60.0f;
+
+	bool operator==(const FOrbitSimulationThreadSettings& Other) const
+	{
+		return Simulation == Other.Simulation && TimeStep == Other.TimeStep && StepRate == Other.StepRate;
+	}
+	bool operator!=(const FOrbitSimulationThreadSettings& Other) const { return !(*this == Other); }
+};
+
+/**
+ * The positions and velocities of all bodies after a step, published by the simulation thread.
+ */
+struct FOrbitSnapshot
+{
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	int64 NumSteps = 0;
+};
+
+/**
+ * Advances an orbit state on a dedicated thread at a fixed rate of real time.
+ * The thread owns its state exclusively. After every step it writes a snapshot into a lock-free triple buffer,
+ * so the game thread always reads the latest complete step without waiting for the solver.
+ */
+class SOLARSYSTEM_API FOrbitSimulationThread : public FRunnable
+{
+public:
+	/**
+	 * Starts the thread with a copy of the core of the chosen precision.
+	 */
+	FOrbitSimulationThread(const FOrbitSimulationCores& InitialCores, const FOrbitSimulationThreadSettings& InSettings);
+	virtual ~FOrbitSimulationThread() override;
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	/**
+	 * Stops the thread and waits until the current step is finished. Afterward the state can be read.
+	 */
+	void Shutdown();
+
+	/**
+	 * Takes over the latest published snapshot, if there is a new one since the last call. Game thread only.
+	 *
+	 * @return const FOrbitSnapshot* The new snapshot or nullptr.
+	 */
+	const FOrbitSnapshot* ReadSnapshot();
+
+	// The cores after the last step. Only safe to read after the shutdown.
+	const FOrbitSimulationCores& GetCores() const { return Cores; }
+	const FOrbitSimulationThreadSettings& GetSettings() const { return Settings; }
+
+private:
+	FOrbitSimulationCores Cores;
+	const FOrbitSimulationThreadSettings Settings;
+	int64 NumSteps = 0;
+
+	TTripleBuffer<FOrbitSnapshot> Snapshots;
+	FThreadSafeBool bStopping;
+	FRunnableThread* Thread = nullptr;
+
+	void PublishSnapshot();
+};
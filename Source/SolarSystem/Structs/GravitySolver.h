@@ -0,0 +1,26 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OrbitCoreTypes.h"
+#include "GravitySolver.generated.h"
+
+/**
+ * The algorithm used to sum up the gravitational accelerations of all bodies.
+ */
+UENUM(BlueprintType)
+enum class EGravitySolver : uint8
+{
+	// Exact all-pairs sum, O(N^2)
+	DirectSum UMETA(DisplayName = "Direct Sum"),
+	// Octree approximation with a configurable opening angle, O(N log N)
+	BarnesHut UMETA(DisplayName = "Barnes-Hut")
+};
+
+static_assert(static_cast<uint8>(EGravitySolver::DirectSum) == static_cast<uint8>(OrbitCore::ESolver::DirectSum)
+	&& static_cast<uint8>(EGravitySolver::BarnesHut) == static_cast<uint8>(OrbitCore::ESolver::BarnesHut),
+	"EGravitySolver must wrap OrbitCore::ESolver value by value");
+
+inline OrbitCore::ESolver ToCore(const EGravitySolver GravitySolver) { return static_cast<OrbitCore::ESolver>(GravitySolver); }
+inline EGravitySolver FromCore(const OrbitCore::ESolver GravitySolver) { return static_cast<EGravitySolver>(GravitySolver); }
@@ -0,0 +1,29 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * The choices of the simulation core as plain enums, without any engine header, so the core does not depend on
+ * the reflection of the editor. EOrbitIntegrator and EGravitySolver are the editor facing wrappers with the same
+ * values, ToCore converts them.
+ */
+namespace OrbitCore
+{
+	enum class EIntegrator : uint8_t
+	{
+		SemiImplicitEuler,
+		Leapfrog,
+		VelocityVerlet,
+		Yoshida4,
+		RungeKutta4,
+		AdaptiveBlockLeapfrog
+	};
+
+	enum class ESolver : uint8_t
+	{
+		DirectSum,
+		BarnesHut
+	};
+}
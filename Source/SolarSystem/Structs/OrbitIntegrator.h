@@ -0,0 +1,39 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OrbitCoreTypes.h"
+#include "OrbitIntegrator.generated.h"
+
+/**
+ * The method used to advance the bodies in time.
+ * The symplectic methods conserve the energy of an orbit over long runs, RK4 does not.
+ */
+UENUM(BlueprintType)
+enum class EOrbitIntegrator : uint8
+{
+	// First order, one force evaluation per step
+	SemiImplicitEuler UMETA(DisplayName = "Semi-Implicit Euler"),
+	// Second order drift-kick-drift, symplectic, one force evaluation per step
+	Leapfrog UMETA(DisplayName = "Leapfrog"),
+	// Second order kick-drift-kick, symplectic, one force evaluation per step by reusing the last one
+	VelocityVerlet UMETA(DisplayName = "Velocity Verlet"),
+	// Fourth order composition of three leapfrog steps, symplectic, three force evaluations per step
+	Yoshida4 UMETA(DisplayName = "Yoshida (4th order)"),
+	// Classic fourth order Runge-Kutta, four force evaluations per step
+	RungeKutta4 UMETA(DisplayName = "Runge-Kutta (4th order)"),
+	// Kick-drift-kick with per-body power-of-two substeps, only bodies that end a substep are evaluated
+	AdaptiveBlockLeapfrog UMETA(DisplayName = "Adaptive Block Leapfrog")
+};
+
+static_assert(static_cast<uint8>(EOrbitIntegrator::SemiImplicitEuler) == static_cast<uint8>(OrbitCore::EIntegrator::SemiImplicitEuler)
+	&& static_cast<uint8>(EOrbitIntegrator::Leapfrog) == static_cast<uint8>(OrbitCore::EIntegrator::Leapfrog)
+	&& static_cast<uint8>(EOrbitIntegrator::VelocityVerlet) == static_cast<uint8>(OrbitCore::EIntegrator::VelocityVerlet)
+	&& static_cast<uint8>(EOrbitIntegrator::Yoshida4) == static_cast<uint8>(OrbitCore::EIntegrator::Yoshida4)
+	&& static_cast<uint8>(EOrbitIntegrator::RungeKutta4) == static_cast<uint8>(OrbitCore::EIntegrator::RungeKutta4)
+	&& static_cast<uint8>(EOrbitIntegrator::AdaptiveBlockLeapfrog) == static_cast<uint8>(OrbitCore::EIntegrator::AdaptiveBlockLeapfrog),
+	"EOrbitIntegrator must wrap OrbitCore::EIntegrator value by value");
+
+inline OrbitCore::EIntegrator ToCore(const EOrbitIntegrator Integrator) { return static_cast<OrbitCore::EIntegrator>(Integrator); }
+inline EOrbitIntegrator FromCore(const OrbitCore::EIntegrator Integrator) { return static_cast<EOrbitIntegrator>(Integrator); }
@@ -0,0 +1,87 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Structure-of-arrays state of all simulated bodies.
+ * Every component lives in its own contiguous array, so the force calculation streams through memory
+ * instead of chasing actor pointers and component transforms for every pair of bodies.
+ * Float is fast and fine for the scaled scenes, double keeps real solar system distances exact.
+ */
+template <typename ScalarType>
+struct TOrbitState
+{
+	TArray<ScalarType> PositionX;
+	TArray<ScalarType> PositionY;
+	TArray<ScalarType> PositionZ;
+
+	TArray<ScalarType> VelocityX;
+	TArray<ScalarType> VelocityY;
+	TArray<ScalarType> VelocityZ;
+
+	TArray<ScalarType> AccelerationX;
+	TArray<ScalarType> AccelerationY;
+	TArray<ScalarType> AccelerationZ;
+
+	TArray<ScalarType> Mass;
+
+	// The first NumSources bodies exert gravity. The bodies after them are massless tracers, which only feel it.
+	int32 NumSources = 0;
+
+	int32 Num() const { return Mass.Num(); }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return PositionX.GetAllocatedSize() + PositionY.GetAllocatedSize() + PositionZ.GetAllocatedSize()
+			+ VelocityX.GetAllocatedSize() + VelocityY.GetAllocatedSize() + VelocityZ.GetAllocatedSize()
+			+ AccelerationX.GetAllocatedSize() + AccelerationY.GetAllocatedSize() + AccelerationZ.GetAllocatedSize()
+			+ Mass.GetAllocatedSize();
+	}
+
+	/**
+	 * Resizes all arrays. Afterward every body is a source again.
+	 */
+	void SetNum(const int32 NewNum)
+	{
+		NumSources = NewNum;
+		PositionX.SetNumZeroed(NewNum);
+		PositionY.SetNumZeroed(NewNum);
+		PositionZ.SetNumZeroed(NewNum);
+		VelocityX.SetNumZeroed(NewNum);
+		VelocityY.SetNumZeroed(NewNum);
+		VelocityZ.SetNumZeroed(NewNum);
+		AccelerationX.SetNumZeroed(NewNum);
+		AccelerationY.SetNumZeroed(NewNum);
+		AccelerationZ.SetNumZeroed(NewNum);
+		Mass.SetNumZeroed(NewNum);
+	}
+
+	FVector GetPosition(const int32 Index) const { return FVector(PositionX[Index], PositionY[Index], PositionZ[Index]); }
+	void SetPosition(const int32 Index, const FVector& Position)
+	{
+		PositionX[Index] = Position.X;
+		PositionY[Index] = Position.Y;
+		PositionZ[Index] = Position.Z;
+	}
+
+	FVector GetVelocity(const int32 Index) const { return FVector(VelocityX[Index], VelocityY[Index], VelocityZ[Index]); }
+	void SetVelocity(const int32 Index, const FVector& Velocity)
+	{
+		VelocityX[Index] = Velocity.X;
+		VelocityY[Index] = Velocity.Y;
+		VelocityZ[Index] = Velocity.Z;
+	}
+
+	FVector GetAcceleration(const int32 Index) const { return FVector(AccelerationX[Index], AccelerationY[Index], AccelerationZ[Index]); }
+	void SetAcceleration(const int32 Index, const FVector& Acceleration)
+	{
+		AccelerationX[Index] = Acceleration.X;
+		AccelerationY[Index] = Acceleration.Y;
+		AccelerationZ[Index] = Acceleration.Z;
+	}
+};
+
+using FOrbitState = TOrbitState<float>;
+using FOrbitStateDouble = TOrbitState<double>;
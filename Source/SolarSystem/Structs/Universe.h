@@ -4,6 +4,7 @@
 
 struct FUniverse
 {
-	static constexpr float GravitationalConstant = 0.1f; // 6.67430e-11f | m^3 kg^-1 s^-2 (scaled down)
+	// Double, so the double precision path gets the exact value. The float paths round it once.
+	static constexpr double GravitationalConstant = 0.1; // 6.67430e-11 | m^3 kg^-1 s^-2 (scaled down)
 	static constexpr float TimeStep = 0.1f;
 };
@@ -0,0 +1,86 @@
+﻿// Copyright (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "Misc/AutomationTest.h"
+#include "SolarSystem/DebugTools/OrbitPredictor.h"
+#include "SolarSystem/Structs/GravitySolver.h"
+#include "SolarSystem/Structs/OrbitIntegrator.h"
+#include "SolarSystem/Structs/Universe.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// A star with planets on circular orbits at different radii, so the adaptive levels differ, followed by tracers
+	TArray<FVirtualBody> MakeSystem(const int32 NumPlanets, const int32 NumTracers)
+	{
+		constexpr double StarMass = 1.0e5;
+		FRandomStream Random(7);
+
+		TArray<FVirtualBody> Bodies;
+		for (int32 i = 0; i < 1 + NumPlanets + NumTracers; ++i)
+		{
+			FVirtualBody& Body = Bodies.Emplace_GetRef(TWeakObjectPtr<ACelestialBody>());
+			Body.Mass = i == 0 ? StarMass : i <= NumPlanets ? Random.FRandRange(1.0f, 10.0f) : 0.0;
+			Body.Location = FVector::ZeroVector;
+			Body.Velocity = FVector::ZeroVector;
+			Body.LineColor = FLinearColor::White;
+			Body.bMasslessTracer = i > NumPlanets;
+			if (i == 0) continue;
+
+			const double Radius = Random.FRandRange(50.0f, 2000.0f);
+			const double Angle = Random.GetFraction() * 2.0 * PI;
+			const double Speed = FMath::Sqrt(FUniverse::GravitationalConstant * StarMass / Radius);
+			Body.Location = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * Radius;
+			Body.Velocity = FVector(-FMath::Sin(Angle), FMath::Cos(Angle), 0.0) * Speed;
+		}
+		return Bodies;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOrbitPredictorAllocationTest, "SolarSystem.Orbit.PredictorAllocations",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FOrbitPredictorAllocationTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumSteps = 256;
+	constexpr int32 NumWarmupSteps = 8;
+	const TArray<FVirtualBody> Bodies = MakeSystem(64, 16);
+
+	for (const bool bDoublePrecision : { false, true })
+	{
+		for (const OrbitCore::ESolver GravitySolver : { OrbitCore::ESolver::DirectSum, OrbitCore::ESolver::BarnesHut })
+		{
+			for (const OrbitCore::EIntegrator Integrator : { OrbitCore::EIntegrator::RungeKutta4, OrbitCore::EIntegrator::AdaptiveBlockLeapfrog })
+			{
+				FOrbitPredictionSettings Settings;
+				Settings.TimeStep = FUniverse::TimeStep;
+				Settings.Simulation.Integrator = Integrator;
+				Settings.Simulation.GravitySolver = GravitySolver;
+				Settings.Simulation.bDoublePrecision = bDoublePrecision;
+
+				FOrbitPredictor Predictor;
+				Predictor.Reset(Bodies, Settings);
+
+				// Every call reserves the points of all target steps and takes at least one step, the first
+				// step sizes the scratch data of the integrator and the solver
+				for (int32 Step = 0; Step < NumWarmupSteps; ++Step)
+				{
+					Predictor.Advance(NumSteps, SMALL_NUMBER);
+				}
+				const SIZE_T WarmSize = Predictor.GetAllocatedSize();
+
+				Predictor.Advance(NumSteps);
+
+				const FString Name = FString::Printf(TEXT("%s, %s, %s"), *UEnum::GetValueAsString(FromCore(Integrator)),
+					*UEnum::GetValueAsString(FromCore(GravitySolver)), bDoublePrecision ? TEXT("double") : TEXT("float"));
+				TestEqual(FString::Printf(TEXT("%s reaches the target steps"), *Name), Predictor.GetNumSteps(), NumSteps);
+				TestEqual(FString::Printf(TEXT("%s steps without allocating"), *Name),
+					static_cast<uint64>(Predictor.GetAllocatedSize()), static_cast<uint64>(WarmSize));
+			}
+		}
+	}
+	return true;
+}
+
+#endif
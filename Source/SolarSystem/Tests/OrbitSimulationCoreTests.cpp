@@ -0,0 +1,189 @@
+﻿// Author (c) 2024 Felix Wahl (https://github.com/goldbarth). Provided under the MIT License. Full text: https://opensource.org/licenses/MIT
+
+
+#include "Misc/AutomationTest.h"
+#include "SolarSystem/Orbit/OrbitSimulationCore.h"
+#include "SolarSystem/Structs/GravitySolver.h"
+#include "SolarSystem/Structs/OrbitIntegrator.h"
+#include "SolarSystem/Structs/Universe.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// A massless tracer on a circular orbit around a central body. The tracer pulls on nothing, so the central
+	// body stays at the origin and the exact orbit is known at every time.
+	constexpr double CentralMass = 1000.0;
+	constexpr double OrbitRadius = 100.0;
+
+	double GetCircularSpeed() { return FMath::Sqrt(FUniverse::GravitationalConstant * CentralMass / OrbitRadius); }
+
+	void SetupTwoBodies(FOrbitSimulationCoreDouble& Core, const OrbitCore::EIntegrator Integrator, const double Speed)
+	{
+		Core.Settings.Integrator = Integrator;
+		Core.State.SetNum(2);
+		Core.State.Mass[0] = CentralMass;
+		Core.State.SetPosition(1, FVector(OrbitRadius, 0.0, 0.0));
+		Core.State.SetVelocity(1, FVector(0.0, Speed, 0.0));
+		Core.State.NumSources = 1;
+		Core.Invalidate();
+	}
+
+	// Distance of the tracer to its exact position after one revolution in the given number of steps
+	double CalculateOrbitError(const OrbitCore::EIntegrator Integrator, const int32 NumSteps)
+	{
+		FOrbitSimulationCoreDouble Core;
+		const double Speed = GetCircularSpeed();
+		SetupTwoBodies(Core, Integrator, Speed);
+
+		// The step is a float, so the exact orbit is taken at the time that was actually integrated
+		const float TimeStep = static_cast<float>(2.0 * PI * OrbitRadius / Speed / NumSteps);
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			Core.Step(TimeStep);
+		}
+
+		const double Angle = Speed / OrbitRadius * NumSteps * static_cast<double>(TimeStep);
+		const FVector Expected(OrbitRadius * FMath::Cos(Angle), OrbitRadius * FMath::Sin(Angle), 0.0);
+		return FVector::Distance(Core.State.GetPosition(1), Expected);
+	}
+
+	// Specific orbital energy of the tracer, e = v^2 / 2 - G * M / r
+	double CalculateOrbitEnergy(const FOrbitSimulationCoreDouble& Core)
+	{
+		const FVector Offset = Core.State.GetPosition(1) - Core.State.GetPosition(0);
+		return 0.5 * Core.State.GetVelocity(1).SizeSquared() - FUniverse::GravitationalConstant * CentralMass / Offset.Size();
+	}
+
+	// Sources spread over a sphere, every third one far heavier than the others
+	void SetupRandomSources(FOrbitSimulationCoreDouble& Core, const int32 NumBodies, const int32 NumSources)
+	{
+		FRandomStream Random(42);
+		Core.State.SetNum(NumBodies);
+		for (int32 i = 0; i < NumBodies; ++i)
+		{
+			Core.State.SetPosition(i, Random.GetUnitVector() * Random.FRandRange(10.0f, 1000.0f));
+			Core.State.Mass[i] = i % 3 == 0 ? Random.FRandRange(1000.0f, 5000.0f) : Random.FRandRange(1.0f, 100.0f);
+		}
+		Core.State.NumSources = NumSources;
+	}
+
+	TArray<FVector> CalculateAccelerations(FOrbitSimulationCoreDouble& Core, const OrbitCore::ESolver GravitySolver)
+	{
+		Core.Settings.GravitySolver = GravitySolver;
+		Core.CalculateAccelerations();
+
+		TArray<FVector> Accelerations;
+		for (int32 i = 0; i < Core.State.Num(); ++i)
+		{
+			Accelerations.Add(Core.State.GetAcceleration(i));
+		}
+		return Accelerations;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOrbitIntegratorConvergenceTest, "SolarSystem.Orbit.IntegratorConvergence",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FOrbitIntegratorConvergenceTest::RunTest(const FString& Parameters)
+{
+	// Halving the step divides the error of a fourth order method by 2^4
+	for (const OrbitCore::EIntegrator Integrator : { OrbitCore::EIntegrator::RungeKutta4, OrbitCore::EIntegrator::Yoshida4 })
+	{
+		const double CoarseError = CalculateOrbitError(Integrator, 64);
+		const double FineError = CalculateOrbitError(Integrator, 128);
+		const double Order = FMath::Log2(CoarseError / FineError);
+		TestTrue(FString::Printf(TEXT("%s converges at fourth order, observed %.2f"), *UEnum::GetValueAsString(FromCore(Integrator)), Order),
+			Order > 3.5 && Order < 4.5);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOrbitVelocityVerletEnergyTest, "SolarSystem.Orbit.VelocityVerletEnergy",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FOrbitVelocityVerletEnergyTest::RunTest(const FString& Parameters)
+{
+	// An eccentric orbit of about 300 time units, run for more than 60 revolutions
+	FOrbitSimulationCoreDouble Core;
+	SetupTwoBodies(Core, OrbitCore::EIntegrator::VelocityVerlet, 0.6 * GetCircularSpeed());
+
+	constexpr int32 NumSteps = 20000;
+	const double InitialEnergy = CalculateOrbitEnergy(Core);
+	double FirstHalfError = 0.0;
+	double SecondHalfError = 0.0;
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		Core.Step(1.0f);
+		const double Error = FMath::Abs((CalculateOrbitEnergy(Core) - InitialEnergy) / InitialEnergy);
+		double& HalfError = Step < NumSteps / 2 ? FirstHalfError : SecondHalfError;
+		HalfError = FMath::Max(HalfError, Error);
+	}
+
+	// A symplectic method oscillates around the initial energy instead of drifting away from it
+	TestTrue(FString::Printf(TEXT("Energy error stays small, observed %g"), SecondHalfError), SecondHalfError < 0.01);
+	TestTrue(FString::Printf(TEXT("Energy error does not grow, observed %g after %g"), SecondHalfError, FirstHalfError),
+		SecondHalfError < 1.5 * FirstHalfError);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOrbitBarnesHutExactTest, "SolarSystem.Orbit.BarnesHutExact",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FOrbitBarnesHutExactTest::RunTest(const FString& Parameters)
+{
+	FOrbitSimulationCoreDouble Core;
+	SetupRandomSources(Core, 64, 64);
+
+	// With an opening angle of 0 no cell is accepted as a whole, so the walk visits every body
+	Core.Settings.OpeningAngle = 0.0f;
+	const TArray<FVector> Expected = CalculateAccelerations(Core, OrbitCore::ESolver::DirectSum);
+	const TArray<FVector> Actual = CalculateAccelerations(Core, OrbitCore::ESolver::BarnesHut);
+
+	double MaxError = 0.0;
+	for (int32 i = 0; i < Expected.Num(); ++i)
+	{
+		MaxError = FMath::Max(MaxError, FVector::Distance(Actual[i], Expected[i]) / Expected[i].Size());
+	}
+	TestTrue(FString::Printf(TEXT("Barnes-Hut matches the direct sum, observed relative error %g"), MaxError), MaxError < 1e-9);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOrbitTracerTest, "SolarSystem.Orbit.Tracers",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FOrbitTracerTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumSources = 8;
+	constexpr int32 NumBodies = 12;
+
+	for (const OrbitCore::ESolver GravitySolver : { OrbitCore::ESolver::DirectSum, OrbitCore::ESolver::BarnesHut })
+	{
+		const FString SolverName = UEnum::GetValueAsString(FromCore(GravitySolver));
+
+		FOrbitSimulationCoreDouble SourcesOnly;
+		SetupRandomSources(SourcesOnly, NumSources, NumSources);
+		const TArray<FVector> Expected = CalculateAccelerations(SourcesOnly, GravitySolver);
+
+		// The tracers get masses far above the sources, which must not matter
+		FOrbitSimulationCoreDouble WithTracers;
+		SetupRandomSources(WithTracers, NumBodies, NumSources);
+		for (int32 i = NumSources; i < NumBodies; ++i)
+		{
+			WithTracers.State.Mass[i] = 1.0e9;
+		}
+		const TArray<FVector> Actual = CalculateAccelerations(WithTracers, GravitySolver);
+
+		for (int32 i = 0; i < NumSources; ++i)
+		{
+			TestEqual(FString::Printf(TEXT("%s: source %d feels no tracer"), *SolverName, i), Actual[i], Expected[i]);
+		}
+		for (int32 i = NumSources; i < NumBodies; ++i)
+		{
+			TestFalse(FString::Printf(TEXT("%s: tracer %d feels the sources"), *SolverName, i), Actual[i].IsZero());
+		}
+	}
+	return true;
+}
+
+#endif